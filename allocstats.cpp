@@ -0,0 +1,137 @@
+#include "allocstats.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+using namespace std;
+
+const char *AllocStats::names[AllocStats::SubsystemSize] = {"other", "input", "solver", "slices", "streams", "render"};
+
+static thread_local int current = AllocStats::Other;    //subsystem the allocations of this thread are charged to
+static atomic<unsigned long> allocations[AllocStats::SubsystemSize];
+static atomic<unsigned long> bytes[AllocStats::SubsystemSize];
+static atomic<unsigned long> frees[AllocStats::SubsystemSize];
+
+static unsigned long frames = 0;                        //frames ended since the last report, GLUT thread only
+static unsigned long reported_allocations[AllocStats::SubsystemSize];
+static unsigned long reported_bytes[AllocStats::SubsystemSize];
+static unsigned long reported_frees[AllocStats::SubsystemSize];
+
+AllocStats::Scope::Scope(Subsystem subsystem)
+{
+      previous = current;
+      current = subsystem;
+}
+
+AllocStats::Scope::~Scope()
+{
+      current = previous;
+}
+
+//record: Count an allocation of 'bytes' bytes for the subsystem of the calling thread
+void AllocStats::record(size_t size)
+{
+      allocations[current].fetch_add(1, memory_order_relaxed);
+      bytes[current].fetch_add(size, memory_order_relaxed);
+}
+
+void AllocStats::record_free()
+{
+      frees[current].fetch_add(1, memory_order_relaxed);
+}
+
+//instrumented: Are all heap allocations counted, or only the ones passed to record()
+bool AllocStats::instrumented()
+{
+#ifdef ALLOC_STATS
+      return true;
+#else
+      return false;
+#endif
+}
+
+//end_frame: Called once per displayed frame; prints a report every REPORT_FRAMES frames when instrumented
+void AllocStats::end_frame()
+{
+      if (!instrumented()) return;
+      if (++frames >= REPORT_FRAMES) report(cout);
+}
+
+//report: Print the allocations per frame of each subsystem since the last report, and start a new period
+void AllocStats::report(ostream &out)
+{
+      unsigned long n = frames ? frames : 1;
+      unsigned long total = 0;
+
+      out << "allocations per frame over " << frames << " frames:";
+      for (int i = 0; i < SubsystemSize; i++)
+      {
+            unsigned long a = allocations[i].load(memory_order_relaxed);
+            unsigned long b = bytes[i].load(memory_order_relaxed);
+            unsigned long f = frees[i].load(memory_order_relaxed);
+            out << " " << names[i] << " " << (double)(a - reported_allocations[i]) / n
+                << " (" << (double)(b - reported_bytes[i]) / n << " B, "
+                << (double)(f - reported_frees[i]) / n << " frees)";
+            total += a - reported_allocations[i];
+            reported_allocations[i] = a;
+            reported_bytes[i] = b;
+            reported_frees[i] = f;
+      }
+      out << " total " << (double)total / n << endl;
+      frames = 0;
+}
+
+
+#ifdef ALLOC_STATS
+
+//--- COUNTING ALLOCATOR ---------------------------------------------------------------------------------------
+void *operator new(size_t size)
+{
+      void *p = malloc(size ? size : 1);
+      if (!p) throw bad_alloc();
+      AllocStats::record(size);
+      return p;
+}
+
+void *operator new[](size_t size)
+{
+      return operator new(size);
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept
+{
+      void *p = malloc(size ? size : 1);
+      if (p) AllocStats::record(size);
+      return p;
+}
+
+void *operator new[](size_t size, const nothrow_t &tag) noexcept
+{
+      return operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept
+{
+      if (!p) return;
+      AllocStats::record_free();
+      free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+      operator delete(p);
+}
+
+void operator delete(void *p, const nothrow_t &) noexcept
+{
+      operator delete(p);
+}
+
+void operator delete[](void *p, const nothrow_t &) noexcept
+{
+      operator delete(p);
+}
+
+#endif
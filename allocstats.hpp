@@ -0,0 +1,47 @@
+#ifndef ALLOCSTATS_HPP
+#define ALLOCSTATS_HPP
+
+#include <cstddef>
+#include <ostream>
+
+// Heap allocation accounting. Built with ALLOC_STATS defined (make ALLOC_STATS=1), the global operator new and
+// delete count every allocation, its size and every free, charged to the subsystem the allocating thread is
+// working for. Without it only the allocations reported explicitly through record() are counted.
+class AllocStats
+{
+
+
+public:
+	enum Subsystem
+	{
+		Other,			//GUI, startup and anything not tagged
+		Input,			//mouse input
+		Solver,			//simulation steps
+		Slices,			//receiving frames and keeping slices
+		Streams,		//seed points and stream surfaces
+		Render,			//drawing
+		SubsystemSize	//auto assigned (last in enum==size of enum)
+	};
+
+	//Scope: Charge the allocations of this thread to 'subsystem' until the scope ends
+	class Scope
+	{
+	public:
+		explicit Scope(Subsystem subsystem);
+		~Scope();
+	private:
+		int previous;
+	};
+
+	static void record(size_t bytes);
+	static void record_free();
+	static bool instrumented();
+	static void end_frame();
+	static void report(std::ostream &out);
+
+	static const char *names[SubsystemSize];
+	static const int REPORT_FRAMES = 600;		//frames between two reports
+
+};
+
+#endif
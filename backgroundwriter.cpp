@@ -0,0 +1,125 @@
+#include "backgroundwriter.hpp"
+
+#include <chrono>
+
+using namespace std;
+
+
+//--- SOLVER GATE --------------------------------------------------------------------------------------------------
+
+void SolverGate::open()
+{
+      active.store(true);
+}
+
+//close: Turn the solver away and wait for it to finish a hand-over in progress
+void SolverGate::close()
+{
+      active.store(false);
+      while (busy.load()) this_thread::yield();
+}
+
+bool SolverGate::is_open() const
+{
+      return active.load(memory_order_relaxed);
+}
+
+//enter: Start a hand-over, solver side. Returns false if the gate is closed; leave() must follow either way.
+bool SolverGate::enter()
+{
+      busy.fetch_add(1);
+      return active.load();
+}
+
+void SolverGate::leave()
+{
+      busy.fetch_sub(1);
+}
+
+
+//--- BACKGROUND WRITER --------------------------------------------------------------------------------------------
+
+//start: Start the writer thread on a ring of 'buffers' buffers (at most MAX_BUFFERS), all free, calling
+//       'write' with the index of every buffer handed over, and let the solver in
+void BackgroundWriter::start(int buffers, function<void(int)> write)
+{
+      this->buffers = buffers < 1 ? 1 : buffers < MAX_BUFFERS ? buffers : MAX_BUFFERS;
+      this->write = write;
+      for (int b = 0; b < MAX_BUFFERS; b++) ready[b].store(false);
+      filled = 0;
+      quit.store(false);
+      thread = std::thread(&BackgroundWriter::run, this);
+      gate.open();
+}
+
+//close: Turn the solver away and wait for a copy in progress. The buffer being filled can then be handed over
+//       from the control side before finish().
+void BackgroundWriter::close()
+{
+      gate.close();
+}
+
+//finish: Write the buffers handed over and stop the writer thread
+void BackgroundWriter::finish()
+{
+      quit.store(true);
+      wake.notify_one();
+      thread.join();
+}
+
+bool BackgroundWriter::enter()
+{
+      return gate.enter();
+}
+
+void BackgroundWriter::leave()
+{
+      gate.leave();
+}
+
+bool BackgroundWriter::is_open() const
+{
+      return gate.is_open();
+}
+
+//filling: The buffer the solver fills next
+int BackgroundWriter::filling() const
+{
+      return filled;
+}
+
+//available: Whether the buffer the solver fills next has been written and given back
+bool BackgroundWriter::available() const
+{
+      return !ready[filled].load();
+}
+
+//hand_over: Hand the buffer being filled to the writer thread and move on to the next one
+void BackgroundWriter::hand_over()
+{
+      ready[filled].store(true);
+      wake.notify_one();
+      filled = (filled + 1) % buffers;
+}
+
+//run: Write the buffers in the order they are handed over, until finish() asks to quit and all handed buffers
+//     are written
+void BackgroundWriter::run()
+{
+      int next = 0;
+      for (;;)
+      {
+            {     //the solver notifies without taking the lock, so a notification can be missed: wait with a timeout
+                  unique_lock<mutex> lock(wake_mutex);
+                  wake.wait_for(lock, chrono::milliseconds(10), [this, next] { return ready[next].load() || quit.load(); });
+            }
+            if (!ready[next].load())
+            {
+                  if (quit.load()) break;
+                  continue;
+            }
+            write(next);
+            ready[next].store(false);
+            next = (next + 1) % buffers;
+      }
+}
@@ -0,0 +1,68 @@
+#ifndef BACKGROUNDWRITER_HPP
+#define BACKGROUNDWRITER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Lets the solver hand frames to a consumer that must never make it wait. The solver brackets every hand-over
+// with enter() and leave(); close() shuts the gate and waits for a hand-over in progress, after which the consumer
+// can free what the solver was writing to.
+class SolverGate
+{
+
+
+public:
+	SolverGate() : active(false), busy(0) {}
+	void open();
+	void close();
+	bool is_open() const;
+	bool enter();
+	void leave();
+
+private:
+	std::atomic<bool> active;
+	std::atomic<int> busy;					//solver between enter() and leave()
+
+};
+
+// A ring of buffers the solver fills and a thread that writes them out, shared by the field recorder and the VTK
+// exporter. The solver fills the buffers in turn and hands each over when it is complete; the writer thread calls
+// 'write' on them in the same order and gives them back. When the buffer the solver comes to next has not been
+// given back yet, the caller drops its frame instead of waiting.
+class BackgroundWriter
+{
+
+
+public:
+	BackgroundWriter() : buffers(0), filled(0), quit(false) {}
+	void start(int buffers, std::function<void(int)> write);
+	void close();
+	void finish();
+	bool enter();
+	void leave();
+	bool is_open() const;
+	int filling() const;
+	bool available() const;
+	void hand_over();
+
+	static const int MAX_BUFFERS = 16;
+
+private:
+	void run();
+
+	SolverGate gate;
+	std::function<void(int)> write;
+	std::atomic<bool> ready[MAX_BUFFERS];	//handed to the writer, the solver keeps off it until it is written
+	int buffers;
+	int filled;								//buffer the solver fills, solver side only
+	std::thread thread;
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	std::atomic<bool> quit;
+
+};
+
+#endif
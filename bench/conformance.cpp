@@ -0,0 +1,248 @@
+#include "conformance.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "../simulation.hpp"
+
+using namespace std;
+
+const char *Conformance::names[Conformance::FieldSize] = {"vx", "vy", "rho"};
+
+// Largest relative L2 error ||field - reference|| / ||reference|| each field may have. Reordering the floating-point
+// operations of a step costs about 1e-15 per step; what the scenario then adds up to stays far below these.
+const double Conformance::tolerances[Conformance::FieldSize] = {1e-6, 1e-6, 1e-6};
+
+static const char MAGIC[8] = {'S', 'M', 'O', 'K', 'E', 'G', 'L', 'D'};
+
+
+//--- REFERENCE SCALAR KERNELS -------------------------------------------------------------------------------------
+// Plain copies of the solver kernels as they were before any optimization, with their own FFTW plans. Keep them
+// as they are: they are what the optimized kernels in simulation.cpp are checked against.
+
+static rfftwnd_plan reference_rc = NULL, reference_cr = NULL;
+static int reference_n = 0;
+
+static void reference_fft(int n, int direction, fftw_real *v)
+{
+      if (reference_n != n)
+      {
+            if (reference_rc) { rfftwnd_destroy_plan(reference_rc); rfftwnd_destroy_plan(reference_cr); }
+            reference_rc = rfftw2d_create_plan(n, n, FFTW_REAL_TO_COMPLEX, FFTW_IN_PLACE);
+            reference_cr = rfftw2d_create_plan(n, n, FFTW_COMPLEX_TO_REAL, FFTW_IN_PLACE);
+            reference_n = n;
+      }
+      if (direction == 1) rfftwnd_one_real_to_complex(reference_rc, v, (fftw_complex*)v);
+      else                rfftwnd_one_complex_to_real(reference_cr, (fftw_complex*)v, v);
+}
+
+static void reference_solve(int n, fftw_real* vx, fftw_real* vy, fftw_real* vx0, fftw_real* vy0, fftw_real visc, fftw_real dt)
+{
+      fftw_real x, y, x0, y0, f, r, U[2], V[2], s, t;
+      int i, j, i0, j0, i1, j1;
+
+      for ( x=0.5f/n,i=0 ; i<n ; i++,x+=1.0f/n )
+         for ( y=0.5f/n,j=0 ; j<n ; j++,y+=1.0f/n )
+         {
+            x0 = n*(x-dt*vx0[i+n*j])-0.5f;
+            y0 = n*(y-dt*vy0[i+n*j])-0.5f;
+            i0 = clamp(x0); s = x0-i0;
+            i0 = (n+(i0%n))%n;
+            i1 = (i0+1)%n;
+            j0 = clamp(y0); t = y0-j0;
+            j0 = (n+(j0%n))%n;
+            j1 = (j0+1)%n;
+            vx[i+n*j] = (1-s)*((1-t)*vx0[i0+n*j0]+t*vx0[i0+n*j1])+s*((1-t)*vx0[i1+n*j0]+t*vx0[i1+n*j1]);
+            vy[i+n*j] = (1-s)*((1-t)*vy0[i0+n*j0]+t*vy0[i0+n*j1])+s*((1-t)*vy0[i1+n*j0]+t*vy0[i1+n*j1]);
+         }
+
+      for(i=0; i<n; i++)
+        for(j=0; j<n; j++)
+        {  vx0[i+(n+2)*j] = vx[i+n*j]; vy0[i+(n+2)*j] = vy[i+n*j]; }
+
+      reference_fft(n, 1, vx0);
+      reference_fft(n, 1, vy0);
+
+      for (i=0;i<=n;i+=2)
+      {
+         x = 0.5f*i;
+         for (j=0;j<n;j++)
+         {
+            y = j<=n/2 ? (fftw_real)j : (fftw_real)j-n;
+            r = x*x+y*y;
+            if ( r==0.0f ) continue;
+            f = (fftw_real)exp(-r*dt*visc);
+            U[0] = vx0[i  +(n+2)*j]; V[0] = vy0[i  +(n+2)*j];
+            U[1] = vx0[i+1+(n+2)*j]; V[1] = vy0[i+1+(n+2)*j];
+
+            vx0[i  +(n+2)*j] = f*((1-x*x/r)*U[0]     -x*y/r *V[0]);
+            vx0[i+1+(n+2)*j] = f*((1-x*x/r)*U[1]     -x*y/r *V[1]);
+            vy0[i+  (n+2)*j] = f*(  -y*x/r *U[0] + (1-y*y/r)*V[0]);
+            vy0[i+1+(n+2)*j] = f*(  -y*x/r *U[1] + (1-y*y/r)*V[1]);
+         }
+      }
+
+      reference_fft(n, -1, vx0);
+      reference_fft(n, -1, vy0);
+
+      f = 1.0/(n*n);
+      for (i=0;i<n;i++)
+         for (j=0;j<n;j++)
+         { vx[i+n*j] = f*vx0[i+(n+2)*j]; vy[i+n*j] = f*vy0[i+(n+2)*j]; }
+}
+
+static void reference_diffuse_matter(int n, fftw_real *vx, fftw_real *vy, fftw_real *rho, fftw_real *rho0, fftw_real dt)
+{
+      fftw_real x, y, x0, y0, s, t;
+      int i, j, i0, j0, i1, j1;
+
+      for ( x=0.5f/n,i=0 ; i<n ; i++,x+=1.0f/n )
+            for ( y=0.5f/n,j=0 ; j<n ; j++,y+=1.0f/n )
+            {
+                  x0 = n*(x-dt*vx[i+n*j])-0.5f;
+                  y0 = n*(y-dt*vy[i+n*j])-0.5f;
+                  i0 = clamp(x0);
+                  s = x0-i0;
+                  i0 = (n+(i0%n))%n;
+                  i1 = (i0+1)%n;
+                  j0 = clamp(y0);
+                  t = y0-j0;
+                  j0 = (n+(j0%n))%n;
+                  j1 = (j0+1)%n;
+                  rho[i+n*j] = (1-s)*((1-t)*rho0[i0+n*j0]+t*rho0[i0+n*j1])+s*((1-t)*rho0[i1+n*j0]+t*rho0[i1+n*j1]);
+            }
+}
+
+
+//--- SCENARIO -----------------------------------------------------------------------------------------------------
+
+Conformance::Conformance(int n, int steps) : n(n), steps(steps)
+{
+}
+
+//reference_step: One simulation step with the reference kernels. Input and forces go through the simulation's own
+//                code, which is not what is being checked.
+void Conformance::reference_step(Simulation &simulation)
+{
+      FieldSet &f = simulation.fields;
+
+      SolverParameters const &parameters = simulation.take_parameters();
+      simulation.apply_input();
+      simulation.set_forces(parameters.dt);
+      reference_solve(n, f.vx, f.vy, f.vx0, f.vy0, parameters.visc, parameters.dt);
+      reference_diffuse_matter(n, f.vx, f.vy, f.rho, f.rho0, parameters.dt);
+}
+
+//scenario: The fixed scenario: a circling stroke through the middle of the grid for the first half of the steps,
+//          then free flow. Runs with the simulation's kernels, or with the reference kernels.
+void Conformance::scenario(Simulation &simulation, bool reference)
+{
+      simulation.dt = 0.4;
+      simulation.visc = 0.001;
+      simulation.brush_radius = 1.5;
+      simulation.share_parameters();
+
+      for (int k = 0; k < steps; k++)
+      {
+            if (k < steps / 2)
+            {
+                  float a = k * 0.2f, x = n * (0.5f + 0.25f * cos(a)), y = n * (0.5f + 0.25f * sin(a));
+                  simulation.insert_forces(x, y, x + 1, y + 1, 0.1 * -sin(a), 0.1 * cos(a));
+            }
+            if (reference) reference_step(simulation);
+            else simulation.do_one_simulation_step(k);
+      }
+}
+
+void Conformance::fields(Simulation &simulation, vector<double> out[FieldSize])
+{
+      FieldSet &f = simulation.fields;
+      fftw_real *in[FieldSize] = {f.vx, f.vy, f.rho};
+      for (int c = 0; c < FieldSize; c++) out[c].assign(in[c], in[c] + n * n);
+}
+
+//write: Run the scenario with the simulation's kernels and write the fields to 'golden'
+bool Conformance::write(const char *golden)
+{
+      vector<double> out[FieldSize];
+      FILE *file = fopen(golden, "wb");
+      if (!file) return false;
+
+      Simulation::DIM = n;
+      Simulation simulation;
+      scenario(simulation, false);
+      fields(simulation, out);
+
+      fwrite(MAGIC, 1, sizeof(MAGIC), file);
+      fwrite(&n, sizeof(n), 1, file);
+      fwrite(&steps, sizeof(steps), 1, file);
+      for (int c = 0; c < FieldSize; c++) fwrite(out[c].data(), sizeof(double), n * n, file);
+      return fclose(file) == 0;
+}
+
+bool Conformance::read(const char *golden, vector<double> out[FieldSize])
+{
+      char magic[sizeof(MAGIC)];
+      int file_n = 0, file_steps = 0;
+      bool ok;
+      FILE *file = fopen(golden, "rb");
+      if (!file) return false;
+
+      ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && !memcmp(magic, MAGIC, sizeof(MAGIC)) &&
+           fread(&file_n, sizeof(int), 1, file) == 1 && fread(&file_steps, sizeof(int), 1, file) == 1 &&
+           file_n == n && file_steps == steps;
+      for (int c = 0; ok && c < FieldSize; c++)
+      {
+            out[c].resize(n * n);
+            ok = fread(out[c].data(), sizeof(double), n * n, file) == (size_t)(n * n);
+      }
+      fclose(file);
+      if (!ok) fprintf(stderr, "%s is not a golden file for a %dx%d grid after %d steps\n", golden, n, n, steps);
+      return ok;
+}
+
+//check: Run the scenario with the simulation's kernels and compare the fields with the reference kernels, or with
+//       'golden' if given. 'tolerance' > 0 overrides the tolerances of all fields. Returns the number of fields
+//       that are out of tolerance, or -1 if the golden file could not be read.
+int Conformance::check(const char *golden, double tolerance)
+{
+      vector<double> result[FieldSize], expected[FieldSize];
+      int failures = 0;
+
+      Simulation::DIM = n;
+      if (golden)
+      {
+            if (!read(golden, expected)) return -1;
+      }
+      else
+      {
+            Simulation reference;
+            scenario(reference, true);
+            fields(reference, expected);
+      }
+      Simulation simulation;
+      scenario(simulation, false);
+      fields(simulation, result);
+
+      printf("%-6s %5s %6s %12s %12s %12s %s\n", "field", "n", "steps", "max abs err", "rel L2 err", "tolerance",
+             golden ? golden : "(reference kernels)");
+      for (int c = 0; c < FieldSize; c++)
+      {
+            double max_error = 0, error2 = 0, norm2 = 0;
+            for (int i = 0; i < n * n; i++)
+            {
+                  double d = result[c][i] - expected[c][i];
+                  max_error = max(max_error, fabs(d));
+                  error2 += d * d;
+                  norm2 += expected[c][i] * expected[c][i];
+            }
+            double relative = norm2 > 0 ? sqrt(error2 / norm2) : sqrt(error2);
+            double limit = tolerance > 0 ? tolerance : tolerances[c];
+            bool pass = relative <= limit && relative == relative;   //NaN fails
+            failures += !pass;
+            printf("%-6s %5d %6d %12.3e %12.3e %12.3e %s\n", names[c], n, steps, max_error, relative, limit,
+                   pass ? "ok" : "FAIL");
+      }
+      return failures;
+}
@@ -0,0 +1,44 @@
+#ifndef CONFORMANCE_HPP
+#define CONFORMANCE_HPP
+
+#include <string>
+#include <vector>
+
+class Simulation;
+
+// Golden-field conformance: runs a fixed scenario (force script, grid size, dt and viscosity) and checks the fields
+// the solver ends up with against the reference scalar kernels kept in conformance.cpp, or against a golden file
+// written by an earlier run. Every field gets its own error norms and tolerance, so an optimized kernel that only
+// reorders floating-point operations passes and one that changes the physics fails.
+class Conformance
+{
+
+
+public:
+	enum Field
+	{
+		VelocityX,
+		VelocityY,
+		Density,
+		FieldSize			//auto assigned (last in enum==size of enum)
+	};
+
+	Conformance(int n, int steps);
+	int check(const char *golden, double tolerance);
+	bool write(const char *golden);
+
+	static const char *names[FieldSize];
+	static const double tolerances[FieldSize];
+
+private:
+	void scenario(Simulation &simulation, bool reference);
+	void reference_step(Simulation &simulation);
+	bool read(const char *golden, std::vector<double> fields[FieldSize]);
+	void fields(Simulation &simulation, std::vector<double> out[FieldSize]);
+
+	int n;						//grid size
+	int steps;					//number of steps in the scenario
+
+};
+
+#endif
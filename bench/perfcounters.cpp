@@ -0,0 +1,99 @@
+#include "perfcounters.hpp"
+
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char *PerfCounters::names[PerfCounters::CounterSize] = {"cycles", "instructions", "l1_misses", "llc_misses",
+      "branch_misses"};
+
+#ifdef __linux__
+
+//open_counter: Open one counter of the calling thread, in user space only, in the group of 'group' (-1 to lead)
+static int open_counter(uint32_t type, uint64_t config, int group)
+{
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = type;
+      attr.config = config;
+      attr.disabled = group == -1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+PerfCounters::PerfCounters()
+{
+      const uint32_t types[CounterSize] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                           PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+      const uint64_t configs[CounterSize] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+      int open = 0;
+
+      group = -1;
+      for (int c = 0; c < CounterSize; c++)
+      {
+            fds[c] = open_counter(types[c], configs[c], group);
+            slots[c] = fds[c] < 0 ? -1 : open++;
+            if (group == -1) group = fds[c];
+      }
+      if (group != -1)
+      {
+            ioctl(group, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+      }
+}
+
+PerfCounters::~PerfCounters()
+{
+      for (int c = 0; c < CounterSize; c++)
+            if (fds[c] >= 0) close(fds[c]);
+}
+
+//read: Current value of every counter since the group was opened, 0 for the counters that are not available
+void PerfCounters::read(uint64_t values[CounterSize]) const
+{
+      uint64_t buffer[1 + CounterSize];     //number of counters, then their values in the order they were opened
+
+      memset(values, 0, CounterSize * sizeof(uint64_t));
+      if (group == -1 || ::read(group, buffer, sizeof(buffer)) <= 0) return;
+      for (int c = 0; c < CounterSize; c++)
+            if (slots[c] >= 0 && (uint64_t)slots[c] < buffer[0]) values[c] = buffer[1 + slots[c]];
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+      group = -1;
+      for (int c = 0; c < CounterSize; c++) fds[c] = slots[c] = -1;
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::read(uint64_t values[CounterSize]) const
+{
+      memset(values, 0, CounterSize * sizeof(uint64_t));
+}
+
+#endif
+
+bool PerfCounters::available() const
+{
+      return group != -1;
+}
+
+bool PerfCounters::has(Counter counter) const
+{
+      return fds[counter] >= 0;
+}
@@ -0,0 +1,43 @@
+#ifndef PERFCOUNTERS_HPP
+#define PERFCOUNTERS_HPP
+
+#include <cstdint>
+
+// Hardware performance counters of the calling thread, read through perf_event_open (Linux only). The counters
+// are opened as one group, so they all count over exactly the same instructions. Counters the machine does not
+// have, or that perf_event_paranoid does not allow, are left out; available() tells whether any could be opened.
+class PerfCounters
+{
+
+
+public:
+	enum Counter
+	{
+		Cycles,
+		Instructions,
+		L1Misses,			//level 1 data cache read misses
+		LLCMisses,			//last level cache misses
+		BranchMisses,
+		CounterSize			//auto assigned (last in enum==size of enum)
+	};
+
+	PerfCounters();
+	~PerfCounters();
+
+	bool available() const;
+	bool has(Counter counter) const;
+	void read(uint64_t values[CounterSize]) const;
+
+	static const char *names[CounterSize];
+
+private:
+	PerfCounters(const PerfCounters &);
+	PerfCounters &operator=(const PerfCounters &);
+
+	int group;					//file descriptor of the group leader, -1 if none could be opened
+	int fds[CounterSize];		//-1 for the counters that could not be opened
+	int slots[CounterSize];		//position of every open counter in the group's read buffer
+
+};
+
+#endif
@@ -0,0 +1,572 @@
+// Usage: smoke-bench [options]
+//        Times the solver and visualization kernels in isolation, for several grid sizes and numbers of
+//        concurrently running solvers, and reports ns per grid cell and effective memory bandwidth.
+//
+//        --sizes 32,60,128      grid sizes to run
+//        --threads 1,2,4        numbers of solvers running at the same time, one per thread
+//        --kernels solve,fft    only run these kernels
+//        --time 0.2             seconds to time every kernel for
+//        --json FILE            write the results to FILE
+//        --baseline FILE        compare against results written earlier with --json
+//        --threshold 0.1        fraction a kernel may be slower than the baseline before it counts as a regression
+//        --counters             also count cycles, instructions, cache and branch misses with perf_event_open
+//
+//        smoke-bench --conformance [--sizes 60] [--steps 200] [--golden FILE | --write-golden FILE] [--tolerance 1e-6]
+//        Runs the fixed conformance scenario and checks the fields against the reference scalar kernels, or against
+//        a golden file written earlier. With several sizes, every size uses its own golden file, FILE.<size>.
+//
+//        smoke-bench --replay FILE [--render] [--record-fields FILE] [--every 1] [--error 0] [--export-vtk FILE.pvd]
+//                    [--share NAME]
+//        Replays an input log recorded in smoke as fast as possible, with or without the visualization's drawing
+//        work, and reports the time per step and a checksum of the final density field. Can record the field
+//        history of the replay, every so many steps, lossily within an absolute error bound if one is given,
+//        export the same steps to ParaView, and publish every step to the shared memory object NAME.
+//
+//        smoke-bench --subscribe NAME [--time SECONDS]
+//        Reads the fields smoke or a replay publishes to the shared memory object NAME for that many seconds, or
+//        until the publisher stops, and reports how many frames it read, how many were overwritten while it read
+//        them, and a checksum of the last density field.
+//
+//        smoke-bench --play FILE [--render]
+//        Plays a recorded field history from start to end as fast as possible, with or without the drawing work,
+//        and reports the time per frame and a checksum of the last density field.
+//--------------------------------------------------------------------------------------------------
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "conformance.hpp"
+#include "perfcounters.hpp"
+#include "../fieldplayer.hpp"
+#include "../fieldpublisher.hpp"
+#include "../fieldrecorder.hpp"
+#include "../fieldsubscriber.hpp"
+#include "../inputlog.hpp"
+#include "../scheduler.hpp"
+#include "../simulation.hpp"
+#include "../visualization.hpp"
+#include "../vtkexporter.hpp"
+
+using namespace std;
+
+// One simulation and visualization instance, warmed up with a force script, that runs single kernels
+class Bench
+{
+
+public:
+    enum Kernel
+    {
+        Solve,
+        Advection,
+        Projection,
+        DiffuseMatter,
+        SetForces,
+        FFTRoundTrip,
+        SliceCapture,
+        ApplyScaling,
+        Colormap,
+        Glyphs,
+        Streamlines,
+        KernelSize      //auto assigned (last in enum==size of enum)
+    };
+
+    static const char *names[KernelSize];
+    static const float arrays[KernelSize];
+
+    Bench();
+    double run(int kernel, PerfCounters const *counters = NULL, uint64_t *counts = NULL);
+
+private:
+    Simulation simulation;
+    Visualization visualization;
+};
+
+const char *Bench::names[Bench::KernelSize] = {"solve", "advection", "projection", "diffuse_matter", "set_forces", "fft", "slice_capture",
+    "apply_scaling", "colormap", "glyphs", "streamlines"};
+
+// Arrays of n*n values each kernel has to read or write at least once, for the bandwidth figures. The real traffic
+// is higher for the kernels that gather (advection) or make several passes (FFT).
+const float Bench::arrays[Bench::KernelSize] = {
+    4,      //solve: vx0, vy0 in, vx, vy out
+    8,      //advection: vx0, vy0 in, vx, vy out, and copied back with padding
+    4,      //projection: vx0, vy0 in and out
+    4,      //diffuse_matter: vx, vy, rho0 in, rho out
+    6,      //set_forces: vx, vy, rho in, vx0, vy0, rho0 out
+    4,      //fft: one array in and out, forward and back
+    18,     //slice_capture: the visible fields of a frame (9 arrays) in and out
+    2,      //apply_scaling: vx, vy in
+    2,      //colormap: vx, vy in
+    4,      //glyphs: vx, vy as scalar and as vector
+    2       //streamlines: vx, vy in
+};
+
+Bench::Bench()
+{
+    const int n = Simulation::DIM;
+
+    for (int k = 0; k < 100; k++) //a fixed force script, to get a busy field
+    {
+        if (k < 30) simulation.insert_forces(n/6 + k % (n/2), n/3 + k/2, 0.1*cos(k*0.2), 0.1*sin(k*0.2));
+        simulation.do_one_simulation_step(k);
+        simulation.receive_frame();
+    }
+    for (int i = 0; i < 10; i++)
+        for (int j = 0; j < 10; j++)
+            simulation.add_seedpoint(Vector2(50 + 70*i, 50 + 70*j));
+}
+
+//run: Run 'kernel' once and return the time it took in seconds, without the setup it needs. With 'counters',
+//     also adds what the counters counted during the kernel to 'counts'.
+double Bench::run(int kernel, PerfCounters const *counters, uint64_t *counts)
+{
+    const int n = Simulation::DIM;
+    const float size = 800, wn = size / (n + 1), hn = size / (n + 1);
+    FieldSet &fields = simulation.fields;
+    FieldSet const &frame = simulation.frame();
+    float min_value, max_value;
+    chrono::steady_clock::time_point start, end;
+    uint64_t before[PerfCounters::CounterSize], after[PerfCounters::CounterSize];
+
+    switch (kernel) //setup
+    {
+        case Solve: case Advection: case DiffuseMatter: case FFTRoundTrip: simulation.set_forces(simulation.dt); break;
+        case Projection:
+            simulation.set_forces(simulation.dt);
+            simulation.advect(n, fields.vx, fields.vy, fields.vx0, fields.vy0, simulation.dt);
+            simulation.FFT(1, fields.vx0);
+            simulation.FFT(1, fields.vy0);
+            break;
+        case SliceCapture: simulation.publish_frame(0); break;
+    }
+
+    if (counters) counters->read(before);
+    start = chrono::steady_clock::now();
+    switch (kernel)
+    {
+        case Solve: simulation.solve(n, fields.vx, fields.vy, fields.vx0, fields.vy0, simulation.visc, simulation.dt); break;
+        case Advection: simulation.advect(n, fields.vx, fields.vy, fields.vx0, fields.vy0, simulation.dt); break;
+        case Projection: simulation.project(n, fields.vx0, fields.vy0, simulation.visc, simulation.dt); break;
+        case DiffuseMatter: simulation.diffuse_matter(n, fields.vx, fields.vy, fields.rho, fields.rho0, simulation.dt); break;
+        case SetForces: simulation.set_forces(simulation.dt); break;
+        case FFTRoundTrip: simulation.FFT(1, fields.vx0); simulation.FFT(-1, fields.vx0); break;
+        case SliceCapture: simulation.receive_frame(); break;
+        case ApplyScaling: visualization.apply_scaling(simulation, &min_value, &max_value); break;
+        case Colormap:
+            for (int idx = 0; idx < n * n; idx++) visualization.set_colormap(simulation, idx, 0, 1, 0);
+            break;
+        case Glyphs: visualization.draw_vectors(frame.vx, frame.vy, frame.vx, frame.vy, wn, hn, 0, 1, 0, 1); break;
+        case Streamlines: visualization.draw_streamlines(simulation, size, size, wn, hn, 0, 1, 0, 1); break;
+    }
+    end = chrono::steady_clock::now();
+    if (counters)
+    {
+        counters->read(after);
+        for (int c = 0; c < PerfCounters::CounterSize; c++) counts[c] += after[c] - before[c];
+    }
+    return chrono::duration<double>(end - start).count();
+}
+
+
+struct Result
+{
+    string kernel;
+    int n, threads;
+    double ns_per_cell;     //median over the timed runs, averaged over the threads
+    double gb_per_s;        //effective bandwidth of all threads together
+    bool counted;           //the hardware counters below are valid
+    double ipc;             //instructions per cycle
+    double per_cell[PerfCounters::CounterSize];  //counts per cell per run, averaged over the threads
+};
+
+//parse_list: Parse a comma separated list of numbers
+static vector<int> parse_list(const char *text)
+{
+    vector<int> list;
+    for (const char *p = text; *p; )
+    {
+        list.push_back(atoi(p));
+        while (*p && *p != ',') p++;
+        if (*p) p++;
+    }
+    return list;
+}
+
+//measure: Time 'kernel' on 'benches.size()' threads at once, each with its own instance, and count with the
+//         hardware counters of every thread if 'count' is set
+static Result measure(vector<Bench*> &benches, int kernel, double seconds, bool count)
+{
+    const int n = Simulation::DIM, threads = benches.size();
+    vector<double> medians(threads);
+    vector<vector<double> > per_cell(threads, vector<double>(PerfCounters::CounterSize, 0));
+    atomic<int> ready(0), counted(0);
+    vector<thread> workers;
+
+    for (int t = 0; t < threads; t++)
+        workers.push_back(thread([&, t]()
+        {
+            vector<double> times;
+            double total = 0;
+            PerfCounters *counters = count ? new PerfCounters() : NULL; //counts this thread only
+            uint64_t counts[PerfCounters::CounterSize] = {0};
+            if (counters && !counters->available()) { delete counters; counters = NULL; }
+            for (int k = 0; k < 3; k++) benches[t]->run(kernel); //warm the caches
+            ready++;
+            while (ready < threads) this_thread::yield(); //start together, so the threads compete
+            while (total < seconds || times.size() < 10)
+            {
+                times.push_back(benches[t]->run(kernel, counters, counts));
+                total += times.back();
+            }
+            nth_element(times.begin(), times.begin() + times.size()/2, times.end());
+            medians[t] = times[times.size()/2];
+            if (counters)
+            {
+                for (int c = 0; c < PerfCounters::CounterSize; c++)
+                    per_cell[t][c] = counters->has((PerfCounters::Counter)c) ? (double)counts[c] / times.size() / (n * n) : -1;
+                counted++;
+                delete counters;
+            }
+        }));
+    for (int t = 0; t < threads; t++) workers[t].join();
+
+    Result result = {Bench::names[kernel], n, threads, 0, 0, counted == threads, 0, {0}};
+    for (int t = 0; t < threads; t++)
+    {
+        result.ns_per_cell += medians[t] * 1e9 / (n * n) / threads;
+        result.gb_per_s += Bench::arrays[kernel] * n * n * sizeof(fftw_real) / medians[t] * 1e-9;
+        for (int c = 0; c < PerfCounters::CounterSize; c++) result.per_cell[c] += per_cell[t][c] / threads;
+    }
+    if (result.per_cell[PerfCounters::Cycles] > 0)
+        result.ipc = result.per_cell[PerfCounters::Instructions] / result.per_cell[PerfCounters::Cycles];
+    return result;
+}
+
+//write_json: One result per line, so the baseline can be read back without a JSON parser
+static bool write_json(const char *path, vector<Result> const &results)
+{
+    FILE *out = fopen(path, "w");
+    if (!out) return false;
+    fprintf(out, "[\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        Result const &r = results[i];
+        fprintf(out, "{\"kernel\": \"%s\", \"n\": %d, \"threads\": %d, \"ns_per_cell\": %.4f, \"gb_per_s\": %.4f",
+                r.kernel.c_str(), r.n, r.threads, r.ns_per_cell, r.gb_per_s);
+        if (r.counted)
+        {
+            fprintf(out, ", \"ipc\": %.3f", r.ipc);
+            for (int c = 0; c < PerfCounters::CounterSize; c++)
+                if (r.per_cell[c] >= 0) fprintf(out, ", \"%s_per_cell\": %.4f", PerfCounters::names[c], r.per_cell[c]);
+        }
+        fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "]\n");
+    fclose(out);
+    return true;
+}
+
+static bool read_json(const char *path, vector<Result> &results)
+{
+    FILE *in = fopen(path, "r");
+    char line[512], kernel[64];
+    if (!in) return false;
+    while (fgets(line, sizeof(line), in))
+    {
+        Result r;
+        if (sscanf(line, " {\"kernel\": \"%63[^\"]\", \"n\": %d, \"threads\": %d, \"ns_per_cell\": %lf, \"gb_per_s\": %lf",
+                   kernel, &r.n, &r.threads, &r.ns_per_cell, &r.gb_per_s) == 5)
+        {
+            r.kernel = kernel;
+            results.push_back(r);
+        }
+    }
+    fclose(in);
+    return true;
+}
+
+//compare: Print how every result relates to the baseline. Returns the number of regressions.
+static int compare(vector<Result> const &results, vector<Result> const &baseline, double threshold)
+{
+    int regressions = 0;
+    printf("\n%-16s %5s %7s %12s %12s %8s\n", "kernel", "n", "threads", "base ns/cell", "ns/cell", "change");
+    for (size_t i = 0; i < results.size(); i++)
+        for (size_t j = 0; j < baseline.size(); j++)
+        {
+            Result const &r = results[i], &b = baseline[j];
+            if (r.kernel != b.kernel || r.n != b.n || r.threads != b.threads) continue;
+            double change = r.ns_per_cell / b.ns_per_cell - 1;
+            bool regression = change > threshold;
+            regressions += regression;
+            printf("%-16s %5d %7d %12.3f %12.3f %+7.1f%%%s\n", r.kernel.c_str(), r.n, r.threads, b.ns_per_cell,
+                   r.ns_per_cell, change * 100, regression ? "  REGRESSION" : "");
+        }
+    return regressions;
+}
+
+//replay_session: Replay the input log at 'path' step by step, drawing every step when 'render' is set (without a
+//                GL context the drawing calls are no-ops, so that times the visualization's CPU work). Returns false
+//                if the log cannot be read. Records the field history of the replay to 'history', if given,
+//                within 'error_bound', exports it to the VTK collection 'vtk' and publishes it to the shared
+//                memory object 'share', if given.
+static bool replay_session(const char *path, bool render, const char *history, int every, double error_bound,
+                           const char *vtk, const char *share)
+{
+    InputReplay replay;
+    if (!replay.load(path)) return false;
+    Simulation::DIM = replay.grid_size();
+    if (history && !FieldRecorder::start(history, replay.grid_size(), every, error_bound))
+    {
+        fprintf(stderr, "cannot write %s\n", history);
+        return false;
+    }
+    if (vtk && !VtkExporter::start(vtk, replay.grid_size(), every, true))
+    {
+        fprintf(stderr, "cannot write %s\n", vtk);
+        return false;
+    }
+    if (share && !FieldPublisher::start(share, replay.grid_size()))
+    {
+        fprintf(stderr, "cannot create %s\n", share);
+        return false;
+    }
+    Simulation simulation;
+    Visualization visualization;
+    long steps = 0;
+
+    visualization.glut = false;
+    simulation.ensure_plans();
+
+    double start = Scheduler::now();
+    while (replay.apply(simulation, visualization))
+    {
+        simulation.do_one_simulation_step(Scheduler::now());
+        simulation.receive_frame();
+        if (render) visualization.visualize(simulation, replay.window_width(), replay.window_height());
+        steps++;
+    }
+    double elapsed = Scheduler::now() - start;
+    if (history && !FieldRecorder::stop()) fprintf(stderr, "could not write all of %s\n", history);
+    if (vtk && !VtkExporter::stop()) fprintf(stderr, "could not write all of %s\n", vtk);
+    if (share) FieldPublisher::stop();
+
+    FieldSet const &f = simulation.frame();
+    double checksum = 0;
+    for (int i = 0; i < f.n * f.n; i++) checksum += f.rho[i];
+    printf("%-24s %5s %8s %10s %10s %16s\n", "log", "n", "steps", "seconds", "ms/step", "rho checksum");
+    printf("%-24s %5d %8ld %10.3f %10.4f %16.9e\n", path, replay.grid_size(), steps, elapsed,
+           steps ? elapsed * 1000 / steps : 0.0, checksum);
+    return true;
+}
+
+//play_history: Play the field history at 'path' frame by frame, drawing every frame in an 800x800 window when
+//              'render' is set. Returns false if the history cannot be read.
+static bool play_history(const char *path, bool render)
+{
+    FieldPlayer player;
+    if (!player.open(path)) return false;
+    Simulation simulation;
+    Visualization visualization;
+
+    simulation.display_only = true;     //only holds the frames and slices, it never steps
+    Simulation::DIM = player.grid_size();
+    simulation.init_parameters();
+
+    visualization.glut = false;
+    double start = Scheduler::now();
+    for (long frame = 0; frame < player.frames(); frame++)
+    {
+        if (!player.show(frame, simulation))
+        {
+            fprintf(stderr, "frame %ld of %s is damaged\n", frame, path);
+            return false;
+        }
+        simulation.receive_frame();
+        if (render) visualization.visualize(simulation, 800, 800);
+    }
+    double elapsed = Scheduler::now() - start;
+
+    FieldSet const &f = simulation.frame();
+    double checksum = 0;
+    for (int i = 0; i < f.n * f.n; i++) checksum += f.rho[i];
+    printf("%-24s %5s %8s %10s %10s %16s\n", "history", "n", "frames", "seconds", "ms/frame", "rho checksum");
+    printf("%-24s %5d %8ld %10.3f %10.4f %16.9e\n", path, player.grid_size(), player.frames(), elapsed,
+           player.frames() ? elapsed * 1000 / player.frames() : 0.0, checksum);
+    return true;
+}
+
+//watch_fields: Read every new frame published to the shared memory object 'name', for 'seconds' or until the
+//              publisher stops. Returns false if nothing is published under that name.
+static bool watch_fields(const char *name, double seconds)
+{
+    FieldSubscriber subscriber;
+    double start = Scheduler::now(), reading = 0, checksum = 0;
+    long frames = 0, torn = 0;
+    uint64_t seen = 0;
+
+    while (!subscriber.open(name))
+    {
+        if (Scheduler::now() - start > seconds) return false;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    for (;;)
+    {
+        bool live = subscriber.live();          //if not, the last frame is already published
+        if (subscriber.generation() == seen)
+        {
+            if (!live || Scheduler::now() - start >= seconds) break;
+            this_thread::yield();
+            continue;
+        }
+        seen = subscriber.generation();
+        double begin = Scheduler::now(), sum = 0;
+        FieldSet const *f = subscriber.latest();
+        if (!f) continue;
+        for (int i = 0; i < f->n * f->n; i++) sum += f->rho[i];
+        if (!subscriber.intact())
+        {
+            torn++;
+            continue;
+        }
+        reading += Scheduler::now() - begin;
+        checksum = sum;
+        frames++;
+    }
+    printf("%-24s %5s %8s %8s %10s %16s\n", "shared fields", "n", "frames", "torn", "ms/read", "rho checksum");
+    printf("%-24s %5d %8ld %8ld %10.4f %16.9e\n", name, subscriber.grid_size(), frames, torn,
+           frames ? reading * 1000 / frames : 0.0, checksum);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    vector<int> sizes = parse_list("32,60,128"), threads = parse_list("1");
+    vector<string> kernels;
+    const char *json = NULL, *baseline = NULL;
+    double seconds = 0.2, threshold = 0.1, tolerance = 0, error_bound = 0;
+    bool count = false, conformance = false, render = false;
+    const char *golden = NULL, *write_golden = NULL, *replay = NULL, *history = NULL, *play = NULL, *vtk = NULL;
+    const char *share = NULL, *subscribe = NULL;
+    int steps = 200, every = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--counters") { count = true; continue; }
+        if (arg == "--conformance") { conformance = true; continue; }
+        if (arg == "--render") { render = true; continue; }
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) { fprintf(stderr, "%s needs a value\n", arg.c_str()); return 2; }
+        if (arg == "--sizes") sizes = parse_list(value);
+        else if (arg == "--threads") threads = parse_list(value);
+        else if (arg == "--kernels") { for (char *k = strtok(argv[i + 1], ","); k; k = strtok(NULL, ",")) kernels.push_back(k); }
+        else if (arg == "--time") seconds = atof(value);
+        else if (arg == "--json") json = value;
+        else if (arg == "--baseline") baseline = value;
+        else if (arg == "--threshold") threshold = atof(value);
+        else if (arg == "--steps") steps = atoi(value);
+        else if (arg == "--golden") golden = value;
+        else if (arg == "--write-golden") write_golden = value;
+        else if (arg == "--tolerance") tolerance = atof(value);
+        else if (arg == "--replay") replay = value;
+        else if (arg == "--record-fields") history = value;
+        else if (arg == "--every") every = atoi(value);
+        else if (arg == "--error") error_bound = atof(value);
+        else if (arg == "--export-vtk") vtk = value;
+        else if (arg == "--share") share = value;
+        else if (arg == "--subscribe") subscribe = value;
+        else if (arg == "--play") play = value;
+        else { fprintf(stderr, "unknown option %s\n", arg.c_str()); return 2; }
+        i++;
+    }
+    if (play) return play_history(play, render) ? 0 : 2;
+    if (replay) return replay_session(replay, render, history, every, error_bound, vtk, share) ? 0 : 2;
+    if (subscribe) return watch_fields(subscribe, seconds) ? 0 : 2;
+    if (conformance)
+    {
+        int failures = 0;
+        for (size_t s = 0; s < sizes.size(); s++)
+        {
+            const char *file = golden ? golden : write_golden;
+            char path[1024];
+            if (file && sizes.size() > 1) snprintf(path, sizeof(path), "%s.%d", file, sizes[s]);
+            else if (file) snprintf(path, sizeof(path), "%s", file);
+
+            Conformance run(sizes[s], steps);
+            if (write_golden)
+            {
+                if (!run.write(path)) { fprintf(stderr, "cannot write %s\n", path); return 2; }
+                printf("wrote %s\n", path);
+                continue;
+            }
+            int result = run.check(golden ? path : NULL, tolerance);
+            if (result < 0) return 2;
+            failures += result;
+        }
+        if (failures) printf("%d fields out of tolerance\n", failures);
+        return failures ? 1 : 0;
+    }
+
+#ifndef __OPTIMIZE__
+    fprintf(stderr, "Warning: smoke-bench was built without optimization, use the release CFLAGS for real numbers\n");
+#endif
+
+    if (count)
+    {
+        PerfCounters probe;
+        if (!probe.available())
+        {
+            fprintf(stderr, "Warning: no hardware counters (no PMU, or kernel.perf_event_paranoid too strict), timing only\n");
+            count = false;
+        }
+    }
+
+    vector<Result> results;
+    printf("%-16s %5s %7s %10s %8s", "kernel", "n", "threads", "ns/cell", "GB/s");
+    if (count) printf(" %6s %10s %10s %10s", "IPC", "L1 miss/c", "LLC miss/c", "br miss/c");
+    printf("\n");
+    for (size_t s = 0; s < sizes.size(); s++)
+    {
+        Simulation::DIM = sizes[s];
+        for (size_t t = 0; t < threads.size(); t++)
+        {
+            vector<Bench*> benches;
+            for (int k = 0; k < threads[t]; k++) benches.push_back(new Bench()); //FFTW plans are made one at a time
+            for (int kernel = 0; kernel < Bench::KernelSize; kernel++)
+            {
+                if (!kernels.empty() && find(kernels.begin(), kernels.end(), Bench::names[kernel]) == kernels.end())
+                    continue;
+                Result r = measure(benches, kernel, seconds, count);
+                printf("%-16s %5d %7d %10.3f %8.2f", r.kernel.c_str(), r.n, r.threads, r.ns_per_cell, r.gb_per_s);
+                if (r.counted)
+                    printf(" %6.2f %10.4f %10.4f %10.4f", r.ipc, r.per_cell[PerfCounters::L1Misses],
+                           r.per_cell[PerfCounters::LLCMisses], r.per_cell[PerfCounters::BranchMisses]);
+                printf("\n");
+                fflush(stdout);
+                results.push_back(r);
+            }
+            for (size_t k = 0; k < benches.size(); k++) delete benches[k];
+        }
+    }
+
+    if (json && !write_json(json, results)) { fprintf(stderr, "cannot write %s\n", json); return 2; }
+    if (baseline)
+    {
+        vector<Result> base;
+        if (!read_json(baseline, base)) { fprintf(stderr, "cannot read %s\n", baseline); return 2; }
+        int regressions = compare(results, base, threshold);
+        if (regressions)
+        {
+            printf("%d kernels regressed by more than %.0f%%\n", regressions, threshold * 100);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,254 @@
+#include "checkpoint.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fieldcodec.hpp"
+#include "simulation.hpp"
+
+using namespace std;
+
+const char Checkpoint::MAGIC[8] = {'S', 'M', 'O', 'K', 'E', 'C', 'K', 'P'};
+
+// First page of the file. The field blocks follow at the offsets given here, each one padded to a whole page:
+// the solver's fields, then the slices from oldest to newest, then the seed points and stream surface seeds, and
+// last a byte per slice that tells whether it carries its forces. Slices saved with an error bound are one
+// lossy-coded stream instead, of slices_bytes in all.
+struct Header
+{
+      char magic[8];
+      uint32_t version;
+      uint32_t real_size;             //sizeof(fftw_real) of the build that wrote the file
+      int32_t n;                      //grid size
+      int32_t slices;                 //number of slices in the ring
+      int32_t number_of_slices;       //number of slices asked for, the ring follows it on the next frame
+      int32_t seedpoints;
+      int32_t stream_surfaces;
+      int32_t derivatives[Simulation::DerivativeSize];
+      int32_t frozen;
+      float dt, visc, brush_radius;
+      int64_t step;
+      double time;
+      uint64_t fields_offset, fields_bytes;
+      uint64_t slices_offset, slice_bytes;        //the slices are slice_bytes apart, rounded up to a page
+      double slice_error;                         //error bound of the slices, 0 if they are exact
+      uint64_t slices_bytes;                      //length of the lossy stream of slices
+      uint64_t streams_offset;
+      uint64_t forces_offset;                     //the forces flags of the slices
+};
+
+static uint64_t page_align(uint64_t bytes)
+{
+      return (bytes + Checkpoint::PAGE - 1) / Checkpoint::PAGE * Checkpoint::PAGE;
+}
+
+//write_block: Write 'bytes' at 'offset', padding the file with zeros up to there
+static bool write_block(FILE *out, uint64_t offset, const void *data, uint64_t bytes)
+{
+      static const char zeros[Checkpoint::PAGE] = {0};
+      long at = ftell(out);
+      while (at >= 0 && (uint64_t)at < offset)
+      {
+            size_t pad = min<uint64_t>(offset - at, sizeof(zeros));
+            if (fwrite(zeros, 1, pad, out) != pad) return false;
+            at += pad;
+      }
+      return (uint64_t)at == offset && fwrite(data, 1, bytes, out) == bytes;
+}
+
+//save: Write the state of 'simulation' to 'path', the slices within 'slice_error' if it is set. The solver must
+//      not be running. A history kept as keyframes is saved slice by slice too, rebuilding every slice in turn.
+bool Checkpoint::save(const char *path, Simulation const &simulation, double slice_error)
+{
+      FieldSet const &fields = simulation.fields;
+      Header header;
+      vector<uint8_t> stream;
+      vector<fftw_real> decoded;
+      bool ok;
+      FILE *out = fopen(path, "wb");
+      if (!out) return false;
+
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = VERSION;
+      header.real_size = sizeof(fftw_real);
+      header.n = fields.n;
+      header.slices = simulation.slice_count();
+      header.number_of_slices = simulation.number_of_slices;
+      header.seedpoints = Simulation::seedpoints.size();
+      header.stream_surfaces = simulation.stream_surfaces.size();
+      for (int i = 0; i < Simulation::DerivativeSize; i++) header.derivatives[i] = simulation.derivatives[i];
+      header.frozen = simulation.frozen;
+      header.dt = simulation.dt;
+      header.visc = simulation.visc;
+      header.brush_radius = simulation.brush_radius;
+      header.step = simulation.step;
+      header.time = simulation.frames.front_buffer().time;
+      header.fields_offset = PAGE;
+      header.fields_bytes = fields.total_bytes();
+      header.slices_offset = header.fields_offset + page_align(header.fields_bytes);
+      header.slice_bytes = header.slices ? FieldSet::bytes_for(fields.n) : 0;
+      header.streams_offset = header.slices_offset + header.slices * page_align(header.slice_bytes);
+      if (slice_error > 0 && header.slices)
+      {
+            size_t count = header.slice_bytes / sizeof(fftw_real);
+            decoded.resize(count);
+            for (int i = 0; i < header.slices; i++)
+                  FieldCodec::encode_lossy(simulation.slice(i).data(), i ? &decoded[0] : NULL, count, slice_error,
+                                           stream, &decoded[0]);
+            header.slice_error = slice_error;
+            header.slices_bytes = stream.size();
+            header.streams_offset = header.slices_offset + page_align(header.slices_bytes);
+      }
+
+      header.forces_offset = header.streams_offset + (header.seedpoints +
+                             (uint64_t)header.stream_surfaces * Stream_Surface::SEED_POINTS) * sizeof(Vector2);
+
+      ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+           write_block(out, header.fields_offset, fields.data(), header.fields_bytes);
+      if (header.slice_error > 0)
+            ok = ok && write_block(out, header.slices_offset, &stream[0], header.slices_bytes);
+      else for (int i = 0; ok && i < header.slices; i++)
+            ok = write_block(out, header.slices_offset + i * page_align(header.slice_bytes),
+                             simulation.slice(i).data(), header.slice_bytes);
+      if (ok)
+            ok = write_block(out, header.streams_offset, Simulation::seedpoints.data(),
+                             header.seedpoints * sizeof(Vector2));
+      for (int i = 0; ok && i < header.stream_surfaces; i++)
+            ok = fwrite(simulation.stream_surfaces[i].seed_points, sizeof(Vector2), Stream_Surface::SEED_POINTS, out)
+                 == Stream_Surface::SEED_POINTS;
+      for (int i = 0; ok && i < header.slices; i++)
+      {
+            uint8_t forces = simulation.slice(i).forces;
+            ok = fwrite(&forces, 1, 1, out) == 1;
+      }
+      ok = fclose(out) == 0 && ok;
+      return ok;
+}
+
+//restore: Replace the state of 'simulation' by the checkpoint at 'path', resizing the grid if needed. The solver
+//         must not be running. The slices come back as a plain ring, whatever they were kept as when saved, so
+//         keyframes are switched off. Returns false if the file is not a checkpoint of this build, and the simulation is
+//         left as it was; if the lossy slices turn out to be damaged, it is reset on the grid it had.
+bool Checkpoint::restore(const char *path, Simulation &simulation)
+{
+      struct stat info;
+      int fd = open(path, O_RDONLY);
+      if (fd < 0) return false;
+      if (fstat(fd, &info) || (size_t)info.st_size < sizeof(Header))
+      {
+            close(fd);
+            fprintf(stderr, "%s is not a checkpoint\n", path);
+            return false;
+      }
+      const char *file = (const char*)mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);                      //the mapping keeps the file open
+      if (file == MAP_FAILED) return false;
+
+      Header header;
+      memcpy(&header, file, sizeof(header));
+      uint64_t streams_bytes = (header.seedpoints + (uint64_t)header.stream_surfaces * Stream_Surface::SEED_POINTS)
+                               * sizeof(Vector2);
+      bool ok = !memcmp(header.magic, MAGIC, sizeof(MAGIC)) && header.version == VERSION &&
+                header.real_size == sizeof(fftw_real) && header.n > 0 &&
+                (uint64_t)header.n * header.n <= (uint64_t)info.st_size &&    //so bytes_for cannot overflow
+                header.fields_bytes == FieldSet::bytes_for(header.n, true) &&
+                header.slices >= 0 && header.slices <= Simulation::MAX_SLICES &&
+                (header.slices == 0 || header.slice_bytes == FieldSet::bytes_for(header.n)) &&
+                header.seedpoints >= 0 && header.seedpoints <= Simulation::SEEDPOINTS_AMOUNT &&
+                header.stream_surfaces >= 0 && header.stream_surfaces <= Simulation::STREAMSURFACE_SIZE &&
+                header.fields_offset + header.fields_bytes <= header.slices_offset &&
+                header.slice_error >= 0 && header.slices_offset + (header.slice_error > 0 ? header.slices_bytes :
+                header.slices * page_align(header.slice_bytes)) <= header.streams_offset &&
+                header.streams_offset + streams_bytes <= header.forces_offset &&
+                header.forces_offset + header.slices <= (uint64_t)info.st_size;
+      if (!ok)
+      {
+            munmap((void*)file, info.st_size);
+            fprintf(stderr, "%s is not a checkpoint of this build\n", path);
+            return false;
+      }
+      madvise((void*)file, info.st_size, MADV_SEQUENTIAL);
+
+      int previous_n = Simulation::DIM;
+      Simulation::DIM = header.n;
+      simulation.init_simulation();
+      FieldSet &fields = simulation.fields;
+      memcpy(fields.data(), file + header.fields_offset, header.fields_bytes);
+
+      simulation.keyframe_interval = 0;                 //the history would otherwise drop the slices on the next frame
+      simulation.change_keyframe_interval();
+      simulation.slices.clear();
+      simulation.number_of_slices = header.slices;  //a long history goes straight to the scratch file
+      simulation.change_number_of_slices();
+      int skipped = header.slices - simulation.number_of_slices;    //oldest slices left out if it cannot be created
+      FieldSet scratch;                                    //the skipped lossy slices are decoded into it
+      if (skipped > 0 && header.slice_error > 0) scratch.resize(header.n);
+      const uint8_t *cursor = (const uint8_t*)file + header.slices_offset;
+      const uint8_t *end = cursor + header.slices_bytes;
+      const fftw_real *previous = NULL;
+      uint64_t dropped = header.slices_offset;        //the slices before this offset have been read
+      for (int i = 0; ok && i < header.slices; i++)
+      {
+            if (i < skipped && header.slice_error == 0) continue;
+            if (i >= skipped) simulation.slices.push_back(simulation.new_slice());
+            FieldSet &slice = i < skipped ? scratch : simulation.slices.back();
+            if (header.slice_error > 0)
+            {
+                  cursor = FieldCodec::decode_lossy(cursor, end, previous, header.slice_bytes / sizeof(fftw_real),
+                                                    header.slice_error, slice.data());
+                  ok = cursor != NULL;
+                  previous = slice.data();
+            }
+            else memcpy(slice.data(), file + header.slices_offset + i * page_align(header.slice_bytes),
+                                header.slice_bytes);
+            slice.forces = file[header.forces_offset + i] != 0;
+            uint64_t read = header.slice_error > 0 ? cursor - (const uint8_t*)file :
+                            header.slices_offset + (i + 1) * page_align(header.slice_bytes);
+            if (ok && read / PAGE * PAGE > dropped)           //the file is read once, keep it out of the resident set
+            {
+                  madvise((void*)(file + dropped), read / PAGE * PAGE - dropped, MADV_DONTNEED);
+                  dropped = read / PAGE * PAGE;
+            }
+            size_t count = simulation.slices.size();
+            if (simulation.spill.is_open() && count > Simulation::RESIDENT_SLICES)     //out of the resident window
+                  simulation.spill.evict(simulation.slices[count - 1 - Simulation::RESIDENT_SLICES]);
+      }
+
+      const Vector2 *points = (const Vector2*)(file + header.streams_offset);
+      Simulation::seedpoints.assign(points, points + header.seedpoints);
+      points += header.seedpoints;
+      for (int i = 0; i < header.stream_surfaces; i++, points += Stream_Surface::SEED_POINTS)
+            simulation.stream_surfaces.push_back(Stream_Surface(points));
+      munmap((void*)file, info.st_size);
+      if (!ok)
+      {
+            fprintf(stderr, "%s has damaged slices\n", path);
+            Simulation::DIM = previous_n;
+            simulation.init_simulation();
+            return false;
+      }
+
+      simulation.number_of_slices = header.number_of_slices;
+      for (int i = 0; i < Simulation::DerivativeSize; i++) simulation.derivatives[i] = header.derivatives[i];
+      simulation.frozen = header.frozen;
+      simulation.dt = header.dt;
+      simulation.visc = header.visc;
+      simulation.brush_radius = header.brush_radius;
+      simulation.share_parameters();                    //taken on at the next step
+      simulation.step = header.step;
+
+      for (int idx = 0; idx < header.n * header.n; idx++)      //the active set is not saved, it follows the forces
+            if (fields.fx[idx] != 0 || fields.fy[idx] != 0) simulation.activate_force(idx);
+      fields.forces = true;
+      fields.step = header.step;
+      fields.time = header.time;
+      for (int i = 0; i < TripleBuffer<FieldSet>::SIZE; i++) simulation.frames.buffer(i).copy_from(fields);
+      return true;
+}
@@ -0,0 +1,28 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstdint>
+
+class Simulation;
+
+// Binary checkpoint of the complete simulation state: the solver's field block (work arrays included), the
+// parameters, the seed points, the stream surfaces and the slice ring. Every field block starts on a page boundary,
+// so restore() maps the file and copies whole pages straight into the field sets; a long-running scenario warm
+// starts in milliseconds instead of being simulated back to its steady state. With an error bound, the slices are
+// stored lossily, each predicted from the one before it; the solver's fields are always exact, so the run continues
+// from a checkpoint exactly as it would have.
+class Checkpoint
+{
+
+
+public:
+	static bool save(const char *path, Simulation const &simulation, double slice_error = 0);
+	static bool restore(const char *path, Simulation &simulation);
+
+	static const char MAGIC[8];
+	static const uint32_t VERSION = 3;
+	static const uint64_t PAGE = 4096;		//alignment of the blocks in the file
+
+};
+
+#endif
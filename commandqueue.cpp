@@ -0,0 +1,147 @@
+#include "commandqueue.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+const char CommandQueue::MAGIC[8] = {'S', 'M', 'O', 'K', 'E', 'C', 'M', 'D'};
+
+CommandQueue::CommandQueue() : header(NULL), server(false), lane(-1), next(0)
+{
+}
+
+CommandQueue::~CommandQueue()
+{
+      close();
+}
+
+
+//--- SERVER SIDE --------------------------------------------------------------------------------------------------
+
+//create: Create the shared memory object 'name' (as for shm_open, "/smoke-input") with all lanes free. Replaces
+//        an object of that name left behind.
+bool CommandQueue::create(const char *name)
+{
+      close();
+      shm_unlink(name);
+      int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);      //only viewers of the same user steer it
+      if (fd < 0) return false;
+      void *mapped = ftruncate(fd, sizeof(Header)) ? MAP_FAILED :
+                     mmap(NULL, sizeof(Header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);                    //the mapping keeps the object open
+      if (mapped == MAP_FAILED)
+      {
+            shm_unlink(name);
+            return false;
+      }
+      header = new (mapped) Header;
+      memcpy(header->magic, MAGIC, sizeof(MAGIC));
+      header->version = VERSION;
+      header->record_size = sizeof(InputLog::Record);
+      for (int i = 0; i < LANES; i++) header->lanes[i].owner.store(0);
+      this->name = name;
+      server = true;
+      next = 0;
+      return true;
+}
+
+//receive: Take the next record from the lanes in turn. Returns false if all lanes are empty. A lane is read even
+//         after its viewer detached, so the input it sent last is not lost.
+bool CommandQueue::receive(InputLog::Record &record)
+{
+      for (int k = 0; k < LANES; k++)
+      {
+            int i = (next + k) % LANES;
+            if (header->lanes[i].queue.pop(record))
+            {
+                  next = (i + 1) % LANES;
+                  return true;
+            }
+      }
+      return false;
+}
+
+//reclaim: Free the lanes of viewers that are gone. Returns the number of viewers still attached.
+int CommandQueue::reclaim()
+{
+      int attached = 0;
+      for (int i = 0; i < LANES; i++)
+      {
+            int32_t owner = header->lanes[i].owner.load();
+            if (owner && kill(owner, 0) && errno == ESRCH) header->lanes[i].owner.compare_exchange_strong(owner, 0);
+            else if (owner) attached++;
+      }
+      return attached;
+}
+
+
+//--- VIEWER SIDE --------------------------------------------------------------------------------------------------
+
+//attach: Map the shared memory object 'name' a server created and claim a free lane. Returns false if there is
+//        no such object, it was created by a build with a different layout, or all lanes are taken.
+bool CommandQueue::attach(const char *name)
+{
+      struct stat info;
+      close();
+      int fd = shm_open(name, O_RDWR, 0);
+      if (fd < 0) return false;
+      void *mapped = fstat(fd, &info) || (size_t)info.st_size < sizeof(Header) ? MAP_FAILED :
+                     mmap(NULL, sizeof(Header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (mapped == MAP_FAILED) return false;
+      header = (Header*)mapped;
+      if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) || header->version != VERSION ||
+          header->record_size != sizeof(InputLog::Record))
+      {
+            close();
+            fprintf(stderr, "%s is not created by this build\n", name);
+            return false;
+      }
+      for (int i = 0; i < LANES && lane < 0; i++)
+      {
+            int32_t free = 0;
+            if (header->lanes[i].owner.compare_exchange_strong(free, getpid())) lane = i;
+      }
+      if (lane < 0)
+      {
+            close();
+            fprintf(stderr, "%s has no free lane, %d viewers are attached\n", name, LANES);
+            return false;
+      }
+      this->name = name;
+      return true;
+}
+
+//send: Queue a record for the server. Returns false (and drops the record) when the lane is full.
+bool CommandQueue::send(InputLog::Record const &record)
+{
+      return lane >= 0 && header->lanes[lane].queue.push(record);
+}
+
+
+//--- BOTH ---------------------------------------------------------------------------------------------------------
+
+//close: Viewer side, give the lane back; server side, remove the object
+void CommandQueue::close()
+{
+      if (!header) return;
+      if (lane >= 0) header->lanes[lane].owner.store(0);
+      munmap(header, sizeof(Header));
+      if (server) shm_unlink(name.c_str());
+      header = NULL;
+      server = false;
+      lane = -1;
+}
+
+bool CommandQueue::is_open() const
+{
+      return header != NULL;
+}
@@ -0,0 +1,65 @@
+#ifndef COMMANDQUEUE_HPP
+#define COMMANDQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "inputlog.hpp"
+#include "spscqueue.hpp"
+
+// Input from viewer processes to a simulation server, through POSIX shared memory. Every viewer that attaches
+// claims a lane of its own, a single-producer queue of InputLog records, so viewers never contend with each other
+// and a viewer that dies halfway through a send leaves nothing the server could read. The server takes the
+// records from all lanes in turn and frees the lanes of viewers that went away without detaching. A full lane
+// drops the record, as the local mouse queue does; nobody ever waits.
+class CommandQueue
+{
+
+
+public:
+	CommandQueue();
+	~CommandQueue();
+	bool create(const char *name);						//server side
+	bool receive(InputLog::Record &record);
+	int reclaim();
+	bool attach(const char *name);						//viewer side
+	bool send(InputLog::Record const &record);
+	void close();
+	bool is_open() const;
+
+	static const int LANES = 8;				//viewers that can be attached at once
+	static const int LANE_SIZE = 256;		//records that fit in a lane
+
+	// Shared memory layout
+	struct Lane
+	{
+		std::atomic<int32_t> owner;			//process id of the viewer, 0 if the lane is free
+		SpscQueue<InputLog::Record, LANE_SIZE> queue;
+	};
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t record_size;				//sizeof(InputLog::Record) of the build that created it
+		Lane lanes[LANES];
+	};
+
+	static const char MAGIC[8];
+	static const uint32_t VERSION = 1;
+
+private:
+	CommandQueue(const CommandQueue &);
+	CommandQueue &operator=(const CommandQueue &);
+
+	Header *header;						//the mapped shared memory
+	std::string name;
+	bool server;						//created it, rather than attached to it
+	int lane;							//lane claimed, viewer side
+	int next;							//lane to take a record from first, server side
+
+};
+
+#endif
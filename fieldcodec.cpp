@@ -0,0 +1,247 @@
+#include "fieldcodec.hpp"
+
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+static const int WORD = sizeof(fftw_real);
+
+//literals: Append bytes[begin..end) as literal runs: a control byte c < 128 followed by c+1 bytes
+static void literals(const uint8_t *bytes, size_t begin, size_t end, vector<uint8_t> &out)
+{
+      for (; begin < end; begin += 128)
+      {
+            size_t count = end - begin < 128 ? end - begin : 128;
+            out.push_back(count - 1);
+            out.insert(out.end(), bytes + begin, bytes + begin + count);
+      }
+}
+
+//run_length: Append 'bytes' to 'out' as runs: literals, or a control byte c >= 128 followed by one byte that
+//            repeats c-125 times (3 to 130)
+static void run_length(const uint8_t *bytes, size_t size, vector<uint8_t> &out)
+{
+      size_t i = 0, literal = 0;          //start of the pending literals
+      while (i < size)
+      {
+            size_t run = 1;
+            while (i + run < size && run < 130 && bytes[i + run] == bytes[i]) run++;
+            if (run < 3) { i++; continue; }
+            literals(bytes, literal, i, out);
+            out.push_back(125 + run);
+            out.push_back(bytes[i]);
+            i += run;
+            literal = i;
+      }
+      literals(bytes, literal, size, out);
+}
+
+//encode: Append 'field' (count values), compressed against 'previous' (NULL for the first field of a sequence),
+//        to 'out', prefixed by its compressed size as a 32-bit integer
+void FieldCodec::encode(const fftw_real *field, const fftw_real *previous, size_t count, vector<uint8_t> &out)
+{
+      static thread_local vector<uint8_t> planes;
+      const uint8_t *now = (const uint8_t*)field, *before = (const uint8_t*)previous;
+
+      planes.resize(count * WORD);
+      for (size_t i = 0; i < count; i++)
+            for (int b = 0; b < WORD; b++)
+                  planes[b * count + i] = now[i * WORD + b] ^ (before ? before[i * WORD + b] : 0);
+
+      size_t start = out.size();
+      uint32_t size;
+      out.resize(start + sizeof(size));
+      run_length(planes.data(), planes.size(), out);
+      size = out.size() - start - sizeof(size);
+      memcpy(&out[start], &size, sizeof(size));
+}
+
+//decode: Decode one field of 'count' values written by encode() from 'in', with the same 'previous' field.
+//        Returns the first byte after it, or NULL if the data is damaged.
+const uint8_t *FieldCodec::decode(const uint8_t *in, const uint8_t *end, const fftw_real *previous, size_t count,
+                                  fftw_real *field)
+{
+      static thread_local vector<uint8_t> planes;
+      uint32_t size;
+
+      if (end - in < (ptrdiff_t)sizeof(size)) return NULL;
+      memcpy(&size, in, sizeof(size));
+      in += sizeof(size);
+      if ((size_t)(end - in) < size) return NULL;
+      end = in + size;
+
+      planes.resize(count * WORD);
+      size_t at = 0;
+      while (in < end)
+      {
+            uint8_t control = *in++;
+            size_t length = control < 128 ? control + 1 : control - 125;
+            if (at + length > planes.size() || in + (control < 128 ? length : 1) > end) return NULL;
+            if (control < 128) { memcpy(&planes[at], in, length); in += length; }
+            else memset(&planes[at], *in++, length);
+            at += length;
+      }
+      if (at != planes.size()) return NULL;
+
+      uint8_t *now = (uint8_t*)field;
+      const uint8_t *before = (const uint8_t*)previous;
+      for (size_t i = 0; i < count; i++)
+            for (int b = 0; b < WORD; b++)
+                  now[i * WORD + b] = planes[b * count + i] ^ (before ? before[i * WORD + b] : 0);
+      return end;
+}
+
+
+//--- LOSSY --------------------------------------------------------------------------------------------------------
+
+static const uint8_t RAW = 255;               //block marker: the values follow as they are
+static const int HALF = FieldCodec::BLOCK / 2;     //values per 32-bit half of a plane
+
+//Bits: bit[i] = 1 << i, so the plane loops mask with a table instead of shifting every value by its own amount
+static const struct Bits
+{
+      uint32_t bit[HALF];
+      Bits() { for (int i = 0; i < HALF; i++) bit[i] = 1u << i; }
+} bits_of;
+
+static const fftw_real zeros[FieldCodec::BLOCK] = {0};     //the prediction without a previous field
+
+//quantize: Quantize a block of 'count' values against 'previous' to steps of 2*bound, zigzag coded into 'codes',
+//          with the decoded values in 'decoded'. Returns false if a value would end up further than 'bound' away.
+//          Split in three branch-free passes so that each vectorizes: the quotients (zeroed where they are too
+//          large or NaN, so that the conversion is defined), the conversion to integers rounding half away from
+//          zero, and the decoded values. Failures are tracked in a double so the check stays in vector registers.
+static bool quantize(const fftw_real *field, const fftw_real *previous, int count, double bound, uint32_t *codes,
+                     fftw_real *decoded)
+{
+      double step = 2 * bound, inverse = 1 / step;
+      double good = 1, q[FieldCodec::BLOCK];
+      for (int i = 0; i < count; i++)
+      {
+            double x = (field[i] - previous[i]) * inverse;
+            good = fabs(x) < 1e9 ? good : 0;           //NaNs fail too
+            q[i] = fabs(x) < 1e9 ? x : 0;
+      }
+      for (int i = 0; i < count; i++)
+      {
+            int32_t v = (int32_t)(q[i] + copysign(0.5, q[i]));
+            q[i] = v;
+            codes[i] = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+      }
+      for (int i = 0; i < count; i++)
+      {
+            decoded[i] = (fftw_real)(previous[i] + q[i] * step);
+            good = fabs(decoded[i] - field[i]) <= bound ? good : 0;
+      }
+      return good != 0;
+}
+
+//pack: Bit plane b of the BLOCK codes, bit i of the plane being bit b of codes[i]. A bit matrix transpose, one
+//      32-bit half of the plane at a time, vectorized across the values.
+static uint64_t pack(const uint32_t *codes, int b)
+{
+      uint32_t low = 0, high = 0;
+      for (int i = 0; i < HALF; i++) low |= (0u - (codes[i] >> b & 1)) & bits_of.bit[i];
+      for (int i = 0; i < HALF; i++) high |= (0u - (codes[HALF + i] >> b & 1)) & bits_of.bit[i];
+      return (uint64_t)high << 32 | low;
+}
+
+//unpack: The inverse of pack, adding bit plane b to the BLOCK codes
+static void unpack(uint64_t plane, int b, uint32_t *codes)
+{
+      uint32_t low = plane, high = plane >> 32;
+      for (int i = 0; i < HALF; i++) codes[i] |= (uint32_t)((low & bits_of.bit[i]) != 0) << b;
+      for (int i = 0; i < HALF; i++) codes[HALF + i] |= (uint32_t)((high & bits_of.bit[i]) != 0) << b;
+}
+
+//encode_lossy: Append 'field' (count values), each within 'bound' of the original, to 'out', prefixed by its size
+//              as a 32-bit integer. The values are predicted from 'previous', the decoded previous field (NULL for
+//              the first field of a sequence); the decoded values go to 'decoded', the 'previous' of the next field.
+//              'decoded' may be 'previous'.
+void FieldCodec::encode_lossy(const fftw_real *field, const fftw_real *previous, size_t count, double bound,
+                              vector<uint8_t> &out, fftw_real *decoded)
+{
+      uint32_t codes[BLOCK];
+      size_t start = out.size();
+      uint32_t size;
+      out.resize(start + sizeof(size));
+
+      for (size_t at = 0; at < count; at += BLOCK)
+      {
+            int n = count - at < (size_t)BLOCK ? count - at : BLOCK;
+            const fftw_real *before = previous ? previous + at : zeros;
+            if (!quantize(field + at, before, n, bound, codes, decoded + at))
+            {
+                  out.push_back(RAW);
+                  out.insert(out.end(), (const uint8_t*)(field + at), (const uint8_t*)(field + at + n));
+                  memcpy(decoded + at, field + at, n * WORD);
+                  continue;
+            }
+            for (int i = n; i < BLOCK; i++) codes[i] = 0;     //the last block of a field may be short
+            uint32_t all = 0;
+            for (int i = 0; i < BLOCK; i++) all |= codes[i];
+            int bits = 0;
+            while (bits < 32 && all >> bits) bits++;
+            out.push_back(bits);
+            for (int b = 0; b < bits; b++)
+            {
+                  uint64_t plane = pack(codes, b);
+                  uint8_t bytes[8];
+                  for (int k = 0; k < 8; k++) bytes[k] = plane >> 8 * k;
+                  out.insert(out.end(), bytes, bytes + 8);
+            }
+      }
+      size = out.size() - start - sizeof(size);
+      memcpy(&out[start], &size, sizeof(size));
+}
+
+//dequantize: Decode a block of 'count' zigzag codes against 'previous' into 'field', which may be 'previous'
+static void dequantize(const uint32_t *codes, const fftw_real *previous, int count, double step, fftw_real *field)
+{
+      for (int i = 0; i < count; i++)
+      {
+            int32_t v = (int32_t)(codes[i] >> 1) ^ -(int32_t)(codes[i] & 1);
+            field[i] = (fftw_real)(previous[i] + (double)v * step);
+      }
+}
+
+//decode_lossy: Decode one field of 'count' values written by encode_lossy() from 'in', with the same 'previous'
+//              field and bound. 'field' may be 'previous'. Returns the first byte after it, or NULL if the data is
+//              damaged.
+const uint8_t *FieldCodec::decode_lossy(const uint8_t *in, const uint8_t *end, const fftw_real *previous,
+                                        size_t count, double bound, fftw_real *field)
+{
+      uint32_t codes[BLOCK];
+      uint32_t size;
+
+      if (end - in < (ptrdiff_t)sizeof(size)) return NULL;
+      memcpy(&size, in, sizeof(size));
+      in += sizeof(size);
+      if ((size_t)(end - in) < size) return NULL;
+      end = in + size;
+
+      for (size_t at = 0; at < count; at += BLOCK)
+      {
+            int n = count - at < (size_t)BLOCK ? count - at : BLOCK;
+            if (in >= end) return NULL;
+            uint8_t bits = *in++;
+            if (bits == RAW)
+            {
+                  if ((size_t)(end - in) < n * sizeof(fftw_real)) return NULL;
+                  memcpy(field + at, in, n * WORD);
+                  in += n * WORD;
+                  continue;
+            }
+            if (bits > 32 || end - in < 8 * bits) return NULL;
+            memset(codes, 0, sizeof(codes));
+            for (int b = 0; b < bits; b++, in += 8)
+            {
+                  uint64_t plane = 0;
+                  for (int k = 0; k < 8; k++) plane |= (uint64_t)in[k] << 8 * k;
+                  unpack(plane, b, codes);
+            }
+            dequantize(codes, previous ? previous + at : zeros, n, 2 * bound, field + at);
+      }
+      return in == end ? end : NULL;
+}
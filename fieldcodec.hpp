@@ -0,0 +1,35 @@
+#ifndef FIELDCODEC_HPP
+#define FIELDCODEC_HPP
+
+#include <rfftw.h>              //the numerical simulation FFTW library
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Light, lossless compression for a sequence of fields: every value is XORed with the same value of the previous
+// field, which zeroes the sign, exponent and leading mantissa bits wherever the field changes slowly; the bytes
+// are then split into planes (all first bytes, all second bytes, ...) so those zeros line up into long runs, and
+// the planes are run-length encoded. Cheap enough to keep up with the solver on a single background thread.
+// The lossy variant keeps every value within a given absolute error bound instead: the difference to the previous
+// decoded field is quantized to steps of twice the bound, and every block of BLOCK values is bit-plane packed into
+// as many planes as its largest quantized value needs. Blocks that cannot meet the bound (infinities, NaNs, huge
+// jumps) are stored as they are. The encoder predicts from decoded values, so the error does not build up over a
+// sequence.
+class FieldCodec
+{
+
+
+public:
+	static void encode(const fftw_real *field, const fftw_real *previous, size_t count, std::vector<uint8_t> &out);
+	static const uint8_t *decode(const uint8_t *in, const uint8_t *end, const fftw_real *previous, size_t count,
+	                             fftw_real *field);
+	static void encode_lossy(const fftw_real *field, const fftw_real *previous, size_t count, double bound,
+	                         std::vector<uint8_t> &out, fftw_real *decoded);
+	static const uint8_t *decode_lossy(const uint8_t *in, const uint8_t *end, const fftw_real *previous,
+	                                   size_t count, double bound, fftw_real *field);
+
+	static const int BLOCK = 64;			//values per block, one bit of each in a 64-bit plane
+
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "fieldplayer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fieldcodec.hpp"
+#include "simulation.hpp"
+
+using namespace std;
+
+FieldPlayer::FieldPlayer() : file(NULL), size(0), decoded(-1), cursor(NULL), prefetched(-1)
+{
+}
+
+FieldPlayer::~FieldPlayer()
+{
+      close();
+}
+
+//open: Map the recording at 'path' and find its chunks, from the index or, if the recording was cut short, by
+//      walking the chunks. Returns false if 'path' is not a field recording of this build.
+bool FieldPlayer::open(const char *path)
+{
+      struct stat info;
+      close();
+      int fd = ::open(path, O_RDONLY);
+      if (fd < 0) return false;
+      if (fstat(fd, &info) || (size_t)info.st_size < sizeof(header))
+      {
+            ::close(fd);
+            fprintf(stderr, "%s is not a field recording\n", path);
+            return false;
+      }
+      void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);                    //the mapping keeps the file open
+      if (mapped == MAP_FAILED) return false;
+      file = (const uint8_t*)mapped;
+      size = info.st_size;
+
+      memcpy(&header, file, sizeof(header));
+      if (memcmp(header.magic, FieldRecorder::MAGIC, sizeof(FieldRecorder::MAGIC)) ||
+          header.version != FieldRecorder::VERSION || header.real_size != sizeof(fftw_real) ||
+          header.fields != FieldRecorder::FieldSize || header.n <= 0 || header.every <= 0 ||
+          !(header.error_bound >= 0) || !scan())
+      {
+            close();
+            fprintf(stderr, "%s is not a field recording of this build\n", path);
+            return false;
+      }
+
+      first_frame.assign(1, 0);
+      for (size_t c = 0; c < chunks.size(); c++) first_frame.push_back(first_frame.back() + chunks[c].frames);
+      current.assign(FieldRecorder::FieldSize * (size_t)header.n * header.n, 0);
+      return true;
+}
+
+//scan: Collect the chunks from the index at the end of the file; without a valid index, walk the chunks
+bool FieldPlayer::scan()
+{
+      FieldRecorder::Trailer trailer;
+      FieldRecorder::ChunkHeader chunk;
+      chunks.clear();
+
+      if (size >= sizeof(header) + sizeof(trailer))
+      {
+            memcpy(&trailer, file + size - sizeof(trailer), sizeof(trailer));
+            if (!memcmp(trailer.magic, FieldRecorder::MAGIC, sizeof(FieldRecorder::MAGIC)) &&
+                trailer.index_offset + trailer.chunks * sizeof(FieldRecorder::IndexEntry) + sizeof(trailer) == size)
+            {
+                  const FieldRecorder::IndexEntry *index = (const FieldRecorder::IndexEntry*)(file + trailer.index_offset);
+                  chunks.assign(index, index + trailer.chunks);
+            }
+      }
+      if (chunks.empty())
+            for (uint64_t offset = sizeof(header); offset + sizeof(chunk) <= size; )
+            {
+                  memcpy(&chunk, file + offset, sizeof(chunk));
+                  uint64_t end = offset + sizeof(chunk) + chunk.frames * sizeof(int64_t) + chunk.bytes;
+                  if (memcmp(chunk.tag, "CHNK", 4) || !chunk.frames || end > size) break;
+                  FieldRecorder::IndexEntry entry = {offset, *(const int64_t*)(file + offset + sizeof(chunk)),
+                                                     chunk.frames, 0};
+                  chunks.push_back(entry);
+                  offset = end;
+            }
+
+      for (size_t c = 0; c < chunks.size(); c++)        //every chunk must lie within the file
+      {
+            if (chunks[c].offset + sizeof(chunk) > size) return false;
+            memcpy(&chunk, file + chunks[c].offset, sizeof(chunk));
+            if (memcmp(chunk.tag, "CHNK", 4) || chunk.frames != chunks[c].frames ||
+                chunks[c].offset + sizeof(chunk) + chunk.frames * sizeof(int64_t) + chunk.bytes > size) return false;
+      }
+      return true;
+}
+
+void FieldPlayer::close()
+{
+      if (file) munmap((void*)file, size);
+      file = NULL;
+      size = 0;
+      chunks.clear();
+      first_frame.assign(1, 0);
+      decoded = -1;
+      cursor = NULL;
+      prefetched = -1;
+}
+
+long FieldPlayer::frames() const
+{
+      return first_frame.back();
+}
+
+//step: Simulation step 'frame' was recorded at
+long FieldPlayer::step(long frame) const
+{
+      int c = chunk_of(frame);
+      const int64_t *steps = (const int64_t*)(file + chunks[c].offset + sizeof(FieldRecorder::ChunkHeader));
+      return steps[frame - first_frame[c]];
+}
+
+int FieldPlayer::grid_size() const
+{
+      return header.n;
+}
+
+//every: Number of simulation steps between two frames
+int FieldPlayer::every() const
+{
+      return header.every;
+}
+
+int FieldPlayer::chunk_of(long frame) const
+{
+      return upper_bound(first_frame.begin(), first_frame.end(), frame) - first_frame.begin() - 1;
+}
+
+//advise: Prefetch the chunks ahead of 'chunk' in the 'direction' of play and release the ones behind it
+void FieldPlayer::advise(int chunk, int direction)
+{
+      if (chunk == prefetched) return;
+      long page = sysconf(_SC_PAGESIZE);
+      for (int k = -2; k <= PREFETCH; k++)
+      {
+            int c = chunk + k * direction;
+            if (k == -1 || k == 0 || c < 0 || c >= (int)chunks.size()) continue;
+            uint64_t begin = chunks[c].offset / page * page;
+            uint64_t end = c + 1 < (int)chunks.size() ? chunks[c + 1].offset : size;
+            madvise((void*)(file + begin), end - begin, k < 0 ? MADV_DONTNEED : MADV_WILLNEED);
+      }
+      prefetched = chunk;
+}
+
+//decode: Decode 'frame' into 'current'. Frames are compressed against the frame before them in their chunk, so
+//        playing forward costs one decode per frame; any other seek decodes from the start of the chunk.
+bool FieldPlayer::decode(long frame)
+{
+      int c = chunk_of(frame);
+      long k = frame - first_frame[c], from;
+      size_t nn = (size_t)header.n * header.n;
+      const uint8_t *payload = file + chunks[c].offset + sizeof(FieldRecorder::ChunkHeader) +
+                               chunks[c].frames * sizeof(int64_t);
+      const uint8_t *end = payload + ((const FieldRecorder::ChunkHeader*)(file + chunks[c].offset))->bytes;
+
+      if (frame == decoded) return true;
+      if (decoded >= 0 && frame > decoded && chunk_of(decoded) == c) from = decoded - first_frame[c] + 1;
+      else
+      {
+            from = 0;
+            cursor = payload;
+      }
+      advise(c, decoded >= 0 && frame < decoded ? -1 : 1);
+      for (long f = from; f <= k; f++)
+            for (int field = 0; field < FieldRecorder::FieldSize; field++)
+            {
+                  fftw_real *values = &current[field * nn];
+                  if (!cursor) break;
+                  if (header.error_bound > 0)
+                        cursor = FieldCodec::decode_lossy(cursor, end, f ? values : NULL, nn, header.error_bound, values);
+                  else cursor = FieldCodec::decode(cursor, end, f ? values : NULL, nn, values);
+            }
+      decoded = cursor ? frame : -1;
+      return cursor != NULL;
+}
+
+//show: Decode 'frame' and publish it to 'simulation', which must be set up for the recording's grid size and
+//      must not be stepping. Returns false if the frame could not be decoded.
+bool FieldPlayer::show(long frame, Simulation &simulation)
+{
+      size_t nn = (size_t)header.n * header.n;
+      FieldSet &f = simulation.frames.back_buffer();
+      if (frame < 0 || frame >= frames() || f.n != header.n || !decode(frame)) return false;
+
+      memcpy(f.vx, &current[FieldRecorder::VelocityX * nn], nn * sizeof(fftw_real));
+      memcpy(f.vy, &current[FieldRecorder::VelocityY * nn], nn * sizeof(fftw_real));
+      memcpy(f.rho, &current[FieldRecorder::Density * nn], nn * sizeof(fftw_real));
+      f.step = step(frame);
+      f.time = 0;                     //no interpolation between frames
+      simulation.frames.publish();
+      return true;
+}
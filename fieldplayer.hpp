@@ -0,0 +1,57 @@
+#ifndef FIELDPLAYER_HPP
+#define FIELDPLAYER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <rfftw.h>              //the numerical simulation FFTW library
+
+#include "fieldrecorder.hpp"
+
+class Simulation;
+
+// Plays back a field history written by FieldRecorder. The file is mapped rather than read, so only the chunks
+// around the frame being shown are ever in memory and recordings much larger than RAM play just as well; the
+// chunks ahead in the direction of play are prefetched, the ones left behind are released. Frames go straight
+// into the simulation's frame buffer, so the visualization draws them as if the solver had computed them.
+class FieldPlayer
+{
+
+
+public:
+	FieldPlayer();
+	~FieldPlayer();
+	bool open(const char *path);
+	void close();
+	bool show(long frame, Simulation &simulation);
+
+	long frames() const;
+	long step(long frame) const;
+	int grid_size() const;
+	int every() const;
+
+	static const int PREFETCH = 2;			//chunks to prefetch ahead of the frame shown
+
+private:
+	FieldPlayer(const FieldPlayer &);
+	FieldPlayer &operator=(const FieldPlayer &);
+	bool scan();
+	bool decode(long frame);
+	int chunk_of(long frame) const;
+	void advise(int chunk, int direction);
+
+	const uint8_t *file;				//the mapped file
+	size_t size;
+	FieldRecorder::FileHeader header;
+	std::vector<FieldRecorder::IndexEntry> chunks;
+	std::vector<long> first_frame;		//index of the first frame of every chunk, then the number of frames
+
+	std::vector<fftw_real> current;		//the last frame decoded, FieldSize fields of n*n values
+	long decoded;						//index of that frame, -1 if none
+	const uint8_t *cursor;				//where the frame after it starts in its chunk
+	int prefetched;						//chunk the prefetch window was last moved to, -1 if none
+
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "fieldpublisher.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#include "backgroundwriter.hpp"
+#include "fieldset.hpp"
+#include "simulation.hpp"
+
+using namespace std;
+
+const char FieldPublisher::MAGIC[8] = {'S', 'M', 'O', 'K', 'E', 'S', 'H', 'M'};
+
+static char *memory = NULL;                   //the mapped shared memory
+static size_t size = 0;
+static string shm_name;
+static vector<FieldSet> views;                //attached to the fields of every slot
+static SolverGate gate;                       //keeps the solver off the slots while they are unmapped
+
+static FieldPublisher::Header *header()
+{
+      return (FieldPublisher::Header*)memory;
+}
+
+static FieldPublisher::Slot *slot(int i)
+{
+      return (FieldPublisher::Slot*)(memory + FieldPublisher::PAGE + i * header()->slot_bytes);
+}
+
+//publish: Copy a published frame into the next slot, 'derivatives' being the bit mask of the Simulation::Derivative
+//         fields it was computed with. Called by the solver; never waits.
+void FieldPublisher::publish(FieldSet const &fields, int derivatives)
+{
+      if (gate.enter() && fields.n == header()->n)
+      {
+            uint64_t generation = header()->generation.load(memory_order_relaxed);
+            int i = generation % header()->slots;
+            Slot &target = *slot(i);
+            uint64_t sequence = target.sequence.load(memory_order_relaxed);
+
+            target.sequence.store(sequence + 1, memory_order_relaxed);     //odd: readers keep off
+            atomic_thread_fence(memory_order_release);
+            views[i].copy_from(fields);
+            target.step = fields.step;
+            target.time = fields.time;
+            target.forces = views[i].forces;
+            target.derivatives = derivatives;
+            target.input = fields.input;
+            target.input_time = fields.input_time;
+            target.sequence.store(sequence + 2, memory_order_release);
+            header()->generation.store(generation + 1, memory_order_release);
+      }
+      gate.leave();
+}
+
+//start: Create the shared memory object 'name' (as for shm_open, "/smoke-fields") with 'slots' slots for an n*n
+//       grid and start publishing to it. Replaces an object of that name left behind; readers of it keep the old
+//       one until they open the name again.
+bool FieldPublisher::start(const char *name, int n, int slots)
+{
+      if (gate.is_open()) return true;
+      slots = max(slots, 2);
+      uint64_t slot_bytes = (SLOT_DATA + FieldSet::bytes_for(n) + PAGE - 1) / PAGE * PAGE;
+
+      shm_unlink(name);
+      int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+      if (fd < 0) return false;
+      size = PAGE + slots * slot_bytes;
+      void *mapped = ftruncate(fd, size) ? MAP_FAILED : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);                      //the mapping keeps the object open
+      if (mapped == MAP_FAILED)
+      {
+            fprintf(stderr, "Cannot create %.1f MB of shared memory for %s\n", size / 1e6, name);
+            shm_unlink(name);
+            return false;
+      }
+      memory = (char*)mapped;         //zero-filled, so every slot starts at sequence 0 and generation is 0
+      shm_name = name;
+
+      memcpy(header()->magic, MAGIC, sizeof(MAGIC));
+      header()->version = VERSION;
+      header()->real_size = sizeof(fftw_real);
+      header()->n = n;
+      header()->slots = slots;
+      header()->slot_bytes = slot_bytes;
+      header()->pid = getpid();
+      views.resize(slots);
+      for (int i = 0; i < slots; i++) views[i].attach(n, (fftw_real*)((char*)slot(i) + SLOT_DATA));
+      header()->live.store(1, memory_order_release);
+      gate.open();
+      static bool stop_at_exit = atexit(stop) == 0;   //do not leave the object behind in /dev/shm
+      (void)stop_at_exit;
+      return true;
+}
+
+//stop: Stop publishing and remove the shared memory object. Readers that have it mapped keep the last frames and
+//      see that it is no longer live.
+void FieldPublisher::stop()
+{
+      if (!gate.is_open()) return;
+      gate.close();
+
+      header()->live.store(0, memory_order_release);
+      views.clear();
+      munmap(memory, size);
+      shm_unlink(shm_name.c_str());
+      memory = NULL;
+      size = 0;
+}
+
+bool FieldPublisher::publishing()
+{
+      return gate.is_open();
+}
@@ -0,0 +1,59 @@
+#ifndef FIELDPUBLISHER_HPP
+#define FIELDPUBLISHER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+class FieldSet;
+
+// Live fields for other processes: every published frame is copied into the next slot of a ring in POSIX shared
+// memory, laid out as a FieldSet block so readers (FieldSubscriber) can attach field sets to the slots and read
+// vx, vy, rho and the derivative fields without copying them. Every slot has a sequence number that is odd while
+// the slot is written (a seqlock): a reader notes it before reading and checks it after, and retries on a newer
+// slot if the slot changed underneath it. The solver never waits for, or even knows about, the readers; a reader
+// that holds on to a slot longer than SLOTS - 1 steps just finds its data overwritten.
+class FieldPublisher
+{
+
+
+public:
+	static bool start(const char *name, int n, int slots = SLOTS);
+	static void stop();
+	static bool publishing();
+	static void publish(FieldSet const &fields, int derivatives);
+
+	// Shared memory layout: the Header on a page of its own, then the slots, slot_bytes apart, each a Slot followed
+	// by a FieldSet block of the grid at SLOT_DATA
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t real_size;					//sizeof(fftw_real) of the build that publishes
+		int32_t n;							//grid size
+		int32_t slots;
+		uint64_t slot_bytes;				//distance between two slots
+		std::atomic<int32_t> live;			//the publisher is still publishing
+		int32_t pid;						//process id of the publisher
+		std::atomic<uint64_t> generation;	//frames published so far; the newest is in slot (generation-1) % slots
+	};
+
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence;		//odd while the slot is written, bumped twice per frame
+		int64_t step;						//as in FieldSet
+		double time;
+		int32_t forces;
+		int32_t derivatives;				//bit mask of the Simulation::Derivative fields computed for the frame
+		int64_t input;
+		double input_time;
+	};
+
+	static const char MAGIC[8];
+	static const uint32_t VERSION = 2;
+	static const uint64_t PAGE = 4096;		//the header and every slot start on a page
+	static const uint64_t SLOT_DATA = 64;	//offset of the fields in a slot, FieldSet::ALIGNMENT
+	static const int SLOTS = 4;
+
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "fieldrecorder.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "backgroundwriter.hpp"
+#include "fieldcodec.hpp"
+#include "fieldset.hpp"
+
+using namespace std;
+
+const char FieldRecorder::MAGIC[8] = {'S', 'M', 'O', 'K', 'E', 'R', 'E', 'C'};
+
+static const size_t CHUNK_BYTES = 4 << 20;    //aim for chunks of about this many uncompressed bytes
+static const int MAX_CHUNK_FRAMES = 64;
+
+// A chunk being filled by the solver or written by the writer thread
+struct Stage
+{
+      vector<fftw_real> values;               //chunk_frames frames of FieldSize fields of n*n values
+      vector<int64_t> steps;
+      int frames;
+};
+
+static Stage stages[2];
+static BackgroundWriter writer;               //writes a stage while the solver fills the other
+static int grid = 0, interval = 1, chunk_frames = 1;   //grid size, every how many steps to record
+static size_t frame_values = 0;               //values in one frame
+static double error_bound = 0;                //0 for lossless
+
+static atomic<long> recorded(0), dropped(0);
+
+static FILE *file = NULL;                     //writer side from here on
+static vector<FieldRecorder::IndexEntry> chunk_index;
+static vector<uint8_t> compressed;            //the chunk being written
+static vector<fftw_real> decoded;             //the frame as the lossy codec decodes it, what the next one is predicted from
+static uint64_t raw_bytes = 0, written_bytes = 0;
+static bool write_failed = false;
+
+
+//--- WRITER THREAD ------------------------------------------------------------------------------------------------
+
+static void write_chunk(Stage const &stage, vector<uint8_t> &out)
+{
+      size_t nn = (size_t)grid * grid;
+      FieldRecorder::ChunkHeader header = {{'C', 'H', 'N', 'K'}, (uint32_t)stage.frames, 0};
+      FieldRecorder::IndexEntry entry = {0, stage.steps[0], (uint32_t)stage.frames, 0};
+
+      out.clear();
+      for (int f = 0; f < stage.frames; f++)
+            for (int c = 0; c < FieldRecorder::FieldSize; c++)
+            {
+                  const fftw_real *field = &stage.values[f * frame_values + c * nn];
+                  if (error_bound > 0)
+                        FieldCodec::encode_lossy(field, f ? &decoded[c * nn] : NULL, nn, error_bound, out, &decoded[c * nn]);
+                  else FieldCodec::encode(field, f ? field - frame_values : NULL, nn, out);
+            }
+      header.bytes = out.size();
+      entry.offset = ftell(file);
+      write_failed |= fwrite(&header, sizeof(header), 1, file) != 1 ||
+                      fwrite(stage.steps.data(), sizeof(int64_t), stage.frames, file) != (size_t)stage.frames ||
+                      fwrite(out.data(), 1, out.size(), file) != out.size();
+      chunk_index.push_back(entry);
+      raw_bytes += stage.frames * frame_values * sizeof(fftw_real);
+      written_bytes += sizeof(header) + stage.frames * sizeof(int64_t) + out.size();
+}
+
+//write_stage: Write a stage handed over by the solver and empty it
+static void write_stage(int stage)
+{
+      write_chunk(stages[stage], compressed);
+      stages[stage].frames = 0;
+}
+
+
+//--- SOLVER SIDE --------------------------------------------------------------------------------------------------
+
+//record: Copy vx, vy and rho of a published frame into the staging chunk, if the step is one to record.
+//        Called by the solver; drops the step if the writer is still busy with the staging chunk.
+void FieldRecorder::record(FieldSet const &fields)
+{
+      if (writer.enter() && fields.n == grid && fields.step % interval == 0)
+      {
+            Stage &stage = stages[writer.filling()];
+            if (!writer.available()) dropped.fetch_add(1, memory_order_relaxed);
+            else
+            {
+                  size_t nn = (size_t)grid * grid;
+                  fftw_real *frame = &stage.values[stage.frames * frame_values];
+                  memcpy(frame, fields.vx, nn * sizeof(fftw_real));
+                  memcpy(frame + nn, fields.vy, nn * sizeof(fftw_real));
+                  memcpy(frame + 2 * nn, fields.rho, nn * sizeof(fftw_real));
+                  stage.steps[stage.frames] = fields.step;
+                  recorded.fetch_add(1, memory_order_relaxed);
+                  if (++stage.frames == chunk_frames) writer.hand_over();
+            }
+      }
+      writer.leave();
+}
+
+
+//--- CONTROL ------------------------------------------------------------------------------------------------------
+
+//start: Start recording every 'every'-th step of an n*n grid to 'path', lossily within 'error_bound' if it is set
+bool FieldRecorder::start(const char *path, int n, int every, double error_bound)
+{
+      FileHeader header;
+      if (writer.is_open()) return true;
+      file = fopen(path, "wb");
+      if (!file) return false;
+
+      grid = n;
+      interval = max(every, 1);
+      frame_values = FieldSize * (size_t)n * n;
+      ::error_bound = max(error_bound, 0.0);
+      decoded.assign(::error_bound > 0 ? frame_values : 0, 0);
+      chunk_frames = (int)min<size_t>(max<size_t>(CHUNK_BYTES / (frame_values * sizeof(fftw_real)), 1),
+                                      MAX_CHUNK_FRAMES);
+      for (int s = 0; s < 2; s++)
+      {
+            stages[s].values.resize(chunk_frames * frame_values);
+            stages[s].steps.resize(chunk_frames);
+            stages[s].frames = 0;
+      }
+      recorded.store(0);
+      dropped.store(0);
+      chunk_index.clear();
+      raw_bytes = written_bytes = 0;
+      write_failed = false;
+
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = VERSION;
+      header.real_size = sizeof(fftw_real);
+      header.n = n;
+      header.every = interval;
+      header.fields = FieldSize;
+      header.chunk_frames = chunk_frames;
+      header.error_bound = ::error_bound;
+      write_failed = fwrite(&header, sizeof(header), 1, file) != 1;
+
+      writer.start(2, write_stage);
+      return true;
+}
+
+//stop: Stop recording, write the last chunk and the index and close the file. Returns false if it could not be
+//      written completely.
+bool FieldRecorder::stop()
+{
+      if (!writer.is_open()) return false;
+      writer.close();
+      if (stages[writer.filling()].frames) writer.hand_over();
+      writer.finish();
+
+      Trailer trailer;
+      trailer.index_offset = ftell(file);
+      trailer.chunks = chunk_index.size();
+      memcpy(trailer.magic, MAGIC, sizeof(MAGIC));
+      write_failed |= fwrite(chunk_index.data(), sizeof(IndexEntry), chunk_index.size(), file) != chunk_index.size() ||
+                      fwrite(&trailer, sizeof(trailer), 1, file) != 1;
+      write_failed |= fclose(file) != 0;
+      file = NULL;
+      for (int s = 0; s < 2; s++)
+      {
+            vector<fftw_real>().swap(stages[s].values);
+            vector<int64_t>().swap(stages[s].steps);
+      }
+      vector<fftw_real>().swap(decoded);
+      vector<uint8_t>().swap(compressed);
+
+      printf("Recorded %ld steps: %.1f MB of fields compressed to %.1f MB (%.2fx)\n", recorded.load(),
+             raw_bytes / 1e6, written_bytes / 1e6, written_bytes ? (double)raw_bytes / written_bytes : 0.0);
+      if (dropped.load()) fprintf(stderr, "Field writer fell behind, dropped %ld steps\n", dropped.load());
+      return !write_failed;
+}
+
+bool FieldRecorder::recording()
+{
+      return writer.is_open();
+}
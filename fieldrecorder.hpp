@@ -0,0 +1,73 @@
+#ifndef FIELDRECORDER_HPP
+#define FIELDRECORDER_HPP
+
+#include <cstdint>
+
+class FieldSet;
+
+// Full-rate history of vx, vy and rho, streamed to a chunked file. The solver copies every recorded step into one
+// of two staging chunks; a background thread compresses a full chunk with FieldCodec and writes it while the
+// solver fills the other. The solver never waits for the disk: when the writer falls behind by a whole chunk,
+// steps are dropped and counted instead. An index of the chunks is written at the end of the file. With an error
+// bound, the fields are compressed lossily, every value within the bound.
+class FieldRecorder
+{
+
+
+public:
+	enum Field
+	{
+		VelocityX,
+		VelocityY,
+		Density,
+		FieldSize			//auto assigned (last in enum==size of enum)
+	};
+
+	static bool start(const char *path, int n, int every = 1, double error_bound = 0);
+	static bool stop();
+	static bool recording();
+	static void record(FieldSet const &fields);
+
+	// File layout: FileHeader, then chunks of ChunkHeader, the step number of every frame in the chunk (int64) and
+	// the frames, each field compressed against the same field of the frame before it in the chunk. The file ends
+	// with the index, one IndexEntry per chunk, and a Trailer; a file without them (a crash) can still be scanned.
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t real_size;			//sizeof(fftw_real) of the build that wrote the file
+		int32_t n;					//grid size
+		int32_t every;				//every how many steps a frame was recorded
+		int32_t fields;				//FieldSize
+		int32_t chunk_frames;		//most frames in a chunk
+		double error_bound;			//absolute error of the lossy codec, 0 for lossless
+	};
+
+	struct ChunkHeader
+	{
+		char tag[4];				//"CHNK"
+		uint32_t frames;
+		uint64_t bytes;				//size of the compressed frames
+	};
+
+	struct IndexEntry
+	{
+		uint64_t offset;			//of the ChunkHeader
+		int64_t first_step;
+		uint32_t frames;
+		uint32_t reserved;
+	};
+
+	struct Trailer
+	{
+		uint64_t index_offset;
+		uint64_t chunks;
+		char magic[8];
+	};
+
+	static const char MAGIC[8];
+	static const uint32_t VERSION = 2;
+
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "fieldset.hpp"
+#include "allocstats.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <sys/mman.h>
+
+
+//padded: Number of values of an array of 'count' values, rounded up so that the next array stays aligned
+static size_t padded(size_t count)
+{
+      size_t per_line = FieldSet::ALIGNMENT / sizeof(fftw_real);
+      return (count + per_line - 1) / per_line * per_line;
+}
+
+FieldSet::FieldSet()
+{
+      block = NULL;
+      owned = true;
+      visible = total = 0;
+      n = 0;
+      step = 0;
+      time = 0;
+      forces = false;
+      input = 0;
+      input_time = 0;
+      reset_pointers();
+}
+
+FieldSet::FieldSet(int n, bool work)
+{
+      block = NULL;
+      owned = true;
+      visible = total = 0;
+      this->n = 0;
+      reset_pointers();
+      resize(n, work);
+}
+
+FieldSet::FieldSet(FieldSet &&other)
+{
+      block = NULL;
+      owned = true;
+      visible = total = 0;
+      n = 0;
+      reset_pointers();
+      *this = std::move(other);
+}
+
+FieldSet &FieldSet::operator=(FieldSet &&other)
+{
+      if (this == &other) return *this;
+      release();
+      n = other.n; step = other.step; time = other.time; forces = other.forces;
+      input = other.input; input_time = other.input_time;
+      block = other.block; visible = other.visible; total = other.total; owned = other.owned;
+      vx = other.vx; vy = other.vy;
+      vorticity = other.vorticity; divergence = other.divergence;
+      grad_x = other.grad_x; grad_y = other.grad_y;
+      fx = other.fx; fy = other.fy;
+      rho = other.rho;
+      vx0 = other.vx0; vy0 = other.vy0; rho0 = other.rho0;
+
+      other.block = NULL;
+      other.visible = other.total = 0;
+      other.n = 0;
+      other.reset_pointers();
+      return *this;
+}
+
+FieldSet::~FieldSet()
+{
+      release();
+}
+
+//bytes_for: Size of the block of an n*n grid, with or without the solver work arrays
+size_t FieldSet::bytes_for(int n, bool work)
+{
+      size_t fft = padded(n * 2*(n/2+1)), grid = padded(n * n);
+      return (6 * fft + 3 * grid + (work ? 2 * fft + grid : 0)) * sizeof(fftw_real);
+}
+
+//resize: Allocate the fields for an n*n grid, with or without the solver work arrays, and clear them.
+//        Keeps the current block if it already has the right layout.
+void FieldSet::resize(int n, bool work)
+{
+      size_t size = bytes_for(n, work);
+      size_t all = size / sizeof(fftw_real);
+
+      if (block && owned && this->n == n && total == all) { clear(); return; }
+
+      release();
+      if (size >= HUGE_PAGE)
+      {
+            size = (size + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+            if (posix_memalign((void**)&block, HUGE_PAGE, size)) block = NULL;
+#ifdef MADV_HUGEPAGE
+            if (block) madvise(block, size, MADV_HUGEPAGE);
+#endif
+      }
+      else if (posix_memalign((void**)&block, ALIGNMENT, size)) block = NULL;
+      if (!block) abort();
+      AllocStats::record(size);         //not seen by operator new
+      owned = true;
+      layout(n, work);
+      clear();
+}
+
+//attach: Use 'memory', owned by the caller, for the visible fields of an n*n grid instead of a block of its own.
+//        It must hold bytes_for(n) bytes and be aligned to ALIGNMENT. The fields are not cleared.
+void FieldSet::attach(int n, fftw_real *memory)
+{
+      release();
+      block = memory;
+      owned = false;
+      layout(n, false);
+}
+
+//layout: Point the fields into the block
+void FieldSet::layout(int n, bool work)
+{
+      size_t fft = padded(n * 2*(n/2+1)), grid = padded(n * n);
+
+      this->n = n;
+      visible = 6 * fft + 3 * grid;
+      total = bytes_for(n, work) / sizeof(fftw_real);
+      vx         = block;
+      vy         = vx + fft;
+      vorticity  = vy + fft;
+      divergence = vorticity + fft;
+      grad_x     = divergence + fft;
+      grad_y     = grad_x + fft;
+      rho        = grad_y + fft;
+      fx         = rho + grid;
+      fy         = fx + grid;
+      if (work)
+      {
+            vx0  = fy + grid;
+            vy0  = vx0 + fft;
+            rho0 = vy0 + fft;
+      }
+}
+
+//clear: Zero all fields
+void FieldSet::clear()
+{
+      if (block) memset(block, 0, total * sizeof(fftw_real));
+      step = 0;
+      time = 0;
+      forces = false;
+      input = 0;
+      input_time = 0;
+}
+
+//copy_from: Copy the visible state of 'other' in one go. The forces come last in the block, so they can be
+//           left out cheaply when nobody draws them; they are zeroed instead.
+void FieldSet::copy_from(FieldSet const &other, bool with_forces)
+{
+      if (n != other.n || !block) resize(other.n, vx0 != NULL);
+      with_forces = with_forces && other.forces;
+      if (with_forces)
+            memcpy(block, other.block, visible * sizeof(fftw_real));
+      else
+      {
+            memcpy(block, other.block, (fx - block) * sizeof(fftw_real));
+            if (forces) memset(fx, 0, (block + visible - fx) * sizeof(fftw_real));
+      }
+      step = other.step;
+      time = other.time;
+      forces = with_forces;
+      input = other.input;
+      input_time = other.input_time;
+}
+
+//blend: Linearly interpolate the visible state between 'a' (alpha = 0) and 'b' (alpha = 1)
+void FieldSet::blend(FieldSet const &a, FieldSet const &b, fftw_real alpha)
+{
+      fftw_real * __restrict__ out = block;
+      const fftw_real * __restrict__ in0 = a.block;
+      const fftw_real * __restrict__ in1 = b.block;
+
+      for (size_t i = 0; i < visible; i++)
+            out[i] = in0[i] + alpha * (in1[i] - in0[i]);
+      step = b.step;
+      forces = a.forces || b.forces;
+      time = a.time + alpha * (b.time - a.time);
+      input = b.input;
+      input_time = b.input_time;
+}
+
+//bytes: Size of the visible state, in bytes
+size_t FieldSet::bytes() const
+{
+      return visible * sizeof(fftw_real);
+}
+
+//total_bytes: Size of the whole block, the solver work arrays included
+size_t FieldSet::total_bytes() const
+{
+      return total * sizeof(fftw_real);
+}
+
+//data: The whole block, the visible state first and the solver work arrays last
+fftw_real *FieldSet::data()
+{
+      return block;
+}
+
+fftw_real const *FieldSet::data() const
+{
+      return block;
+}
+
+void FieldSet::release()
+{
+      if (block && owned)
+      {
+            AllocStats::record_free();
+            free(block);
+      }
+      block = NULL;
+      visible = total = 0;
+      reset_pointers();
+}
+
+void FieldSet::reset_pointers()
+{
+      vx = vy = vorticity = divergence = grad_x = grad_y = fx = fy = rho = NULL;
+      vx0 = vy0 = rho0 = NULL;
+}
@@ -0,0 +1,70 @@
+#ifndef FIELDSET_HPP
+#define FIELDSET_HPP
+
+#include <rfftw.h>              //the numerical simulation FFTW library
+#include <cstddef>
+
+
+// All fields of one simulation state in a single aligned allocation. The fields that are drawn come first,
+// the solver's work arrays (vx0, vy0, rho0) last and only when asked for, so copying or blending the visible
+// state of one set into another is a single pass over one contiguous block.
+// Field sets own their memory and can be moved but not copied; use copy_from for a bulk copy.
+class FieldSet 
+{
+
+
+public:
+	FieldSet();
+	explicit FieldSet(int n, bool work = false);
+	FieldSet(FieldSet &&other);
+	FieldSet &operator=(FieldSet &&other);
+	~FieldSet();
+
+	void resize(int n, bool work = false);
+	void attach(int n, fftw_real *memory);
+	void clear();
+	void copy_from(FieldSet const &other, bool with_forces = true);
+	void blend(FieldSet const &a, FieldSet const &b, fftw_real alpha);
+	size_t bytes() const;
+	size_t total_bytes() const;
+	fftw_real *data();
+	fftw_real const *data() const;
+	static size_t bytes_for(int n, bool work = false);
+
+	static const size_t ALIGNMENT = 64;                 //cache line, and wide enough for any SIMD load
+	static const size_t HUGE_PAGE = 2 * 1024 * 1024;    //blocks at least this large are backed by huge pages
+
+	int n;                  //grid size
+	long step;              //number of the simulation step these fields belong to
+	double time;            //wall-clock time the step was scheduled for, in seconds
+	bool forces;            //fx and fy hold the forces of this step, otherwise they are zero
+	long input;             //id of the latest mouse event applied up to this step, 0 if none
+	double input_time;      //wall-clock time that mouse event was generated, in seconds
+
+	//visible state; vx, vy and the derivatives are transformed in place, so they have FFTW's padded
+	//size n*2*(n/2+1), but outside solve() they hold n*n values
+	fftw_real *vx, *vy;
+	fftw_real *vorticity, *divergence;
+	fftw_real *grad_x, *grad_y;
+	fftw_real *rho;
+	fftw_real *fx, *fy;
+
+	//solver work arrays, NULL unless allocated with work = true
+	fftw_real *vx0, *vy0;
+	fftw_real *rho0;
+
+private:
+	FieldSet(const FieldSet &);
+	FieldSet &operator=(const FieldSet &);
+	void release();
+	void reset_pointers();
+	void layout(int n, bool work);
+
+	fftw_real *block;
+	size_t visible;         //number of values in the visible part of the block
+	size_t total;           //number of values in the whole block
+	bool owned;             //the block was allocated here, rather than attached
+
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "fieldsubscriber.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "simulation.hpp"
+
+using namespace std;
+
+FieldSubscriber::FieldSubscriber() : memory(NULL), size(0), header(NULL), held(-1), held_sequence(0),
+                                     held_derivatives(0)
+{
+}
+
+FieldSubscriber::~FieldSubscriber()
+{
+      close();
+}
+
+//open: Map the shared memory object 'name' a FieldPublisher publishes to. Returns false if there is none, or it
+//      was published by a build with a different layout.
+bool FieldSubscriber::open(const char *name)
+{
+      struct stat info;
+      close();
+      int fd = shm_open(name, O_RDONLY, 0);
+      if (fd < 0) return false;
+      if (fstat(fd, &info) || (size_t)info.st_size < FieldPublisher::PAGE)
+      {
+            ::close(fd);
+            return false;
+      }
+      void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);                    //the mapping keeps the object open
+      if (mapped == MAP_FAILED) return false;
+      memory = (const char*)mapped;
+      size = info.st_size;
+      header = (FieldPublisher::Header const*)memory;
+
+      if (memcmp(header->magic, FieldPublisher::MAGIC, sizeof(FieldPublisher::MAGIC)) ||
+          header->version != FieldPublisher::VERSION || header->real_size != sizeof(fftw_real) || header->n <= 0 ||
+          header->slots <= 0 || header->slot_bytes < FieldPublisher::SLOT_DATA + FieldSet::bytes_for(header->n) ||
+          FieldPublisher::PAGE + header->slots * header->slot_bytes > size)
+      {
+            close();
+            fprintf(stderr, "%s is not published by this build\n", name);
+            return false;
+      }
+      views.resize(header->slots);     //the fields are only read, through FieldSet const
+      for (int i = 0; i < header->slots; i++)
+            views[i].attach(header->n, (fftw_real*)((char*)&slot(i) + FieldPublisher::SLOT_DATA));
+      return true;
+}
+
+void FieldSubscriber::close()
+{
+      views.clear();
+      if (memory) munmap((void*)memory, size);
+      memory = NULL;
+      size = 0;
+      header = NULL;
+      held = -1;
+}
+
+bool FieldSubscriber::is_open() const
+{
+      return memory != NULL;
+}
+
+//live: Whether the publisher is still publishing, and still running; if not, open the name again for a new one
+bool FieldSubscriber::live() const
+{
+      return header && header->live.load(memory_order_acquire) && !(kill(header->pid, 0) && errno == ESRCH);
+}
+
+//generation: Number of frames published so far, to tell whether there is a new one
+uint64_t FieldSubscriber::generation() const
+{
+      return header ? header->generation.load(memory_order_acquire) : 0;
+}
+
+int FieldSubscriber::grid_size() const
+{
+      return header ? header->n : 0;
+}
+
+FieldPublisher::Slot const &FieldSubscriber::slot(int i) const
+{
+      return *(FieldPublisher::Slot const*)(memory + FieldPublisher::PAGE + i * header->slot_bytes);
+}
+
+//latest: The newest frame that is not being written, attached to its slot, or NULL if there is none yet. Stays
+//        valid as long as intact() says so.
+FieldSet const *FieldSubscriber::latest()
+{
+      uint64_t published = generation();
+      held = -1;
+      for (uint64_t back = 1; back <= min<uint64_t>(published, header->slots); back++)
+      {
+            int i = (published - back) % header->slots;
+            FieldPublisher::Slot const &s = slot(i);
+            uint64_t sequence = s.sequence.load(memory_order_acquire);
+            if (sequence & 1) continue;                 //being written, the one before it is complete
+            FieldSet &view = views[i];
+            view.step = s.step;
+            view.time = s.time;
+            view.forces = s.forces;
+            view.input = s.input;
+            view.input_time = s.input_time;
+            held_derivatives = s.derivatives;
+            atomic_thread_fence(memory_order_acquire);
+            if (s.sequence.load(memory_order_relaxed) != sequence) continue;
+            held = i;
+            held_sequence = sequence;
+            return &view;
+      }
+      return NULL;
+}
+
+//intact: Whether the frame latest() handed out last has not been overwritten since. Check it after reading the
+//        fields: if it fails, what was read may be torn.
+bool FieldSubscriber::intact() const
+{
+      if (held < 0) return false;
+      atomic_thread_fence(memory_order_acquire);
+      return slot(held).sequence.load(memory_order_relaxed) == held_sequence;
+}
+
+//derivatives: Bit mask of the Simulation::Derivative fields computed for the frame latest() handed out last
+int FieldSubscriber::derivatives() const
+{
+      return held_derivatives;
+}
+
+//show: Copy the newest frame into the frame buffer of 'simulation' and publish it, unless it was overwritten while
+//      being copied. 'simulation' must be set up for the published grid size and must not be stepping. Returns
+//      whether a frame was published.
+bool FieldSubscriber::show(Simulation &simulation)
+{
+      FieldSet &f = simulation.frames.back_buffer();
+      FieldSet const *newest = latest();
+      if (!newest || f.n != newest->n) return false;
+      f.copy_from(*newest);
+      if (!intact()) return false;
+      simulation.frames.publish();
+      return true;
+}
@@ -0,0 +1,52 @@
+#ifndef FIELDSUBSCRIBER_HPP
+#define FIELDSUBSCRIBER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "fieldpublisher.hpp"
+#include "fieldset.hpp"
+
+class Simulation;
+
+// Reads the live fields a FieldPublisher in another process publishes. latest() hands out a field set attached
+// straight to the newest complete slot in shared memory, so nothing is copied; as the publisher goes on writing,
+// the reader checks intact() once it is done with the fields, and drops what it read if the slot was overwritten
+// in the meantime. Any number of subscribers can read at once; none of them holds up the publisher or each other.
+// show() copies the newest frame into a simulation's frame buffer instead, for a viewer to draw as its own.
+class FieldSubscriber
+{
+
+
+public:
+	FieldSubscriber();
+	~FieldSubscriber();
+	bool open(const char *name);
+	void close();
+	bool is_open() const;
+	bool live() const;
+	uint64_t generation() const;
+	int grid_size() const;
+
+	FieldSet const *latest();
+	bool intact() const;
+	int derivatives() const;
+	bool show(Simulation &simulation);
+
+private:
+	FieldSubscriber(const FieldSubscriber &);
+	FieldSubscriber &operator=(const FieldSubscriber &);
+	FieldPublisher::Slot const &slot(int i) const;
+
+	const char *memory;					//the mapped shared memory
+	size_t size;
+	FieldPublisher::Header const *header;
+	std::vector<FieldSet> views;		//attached to the fields of every slot
+	int held;							//slot latest() handed out last, -1 if none
+	uint64_t held_sequence;				//its sequence number when it was handed out
+	int held_derivatives;
+
+};
+
+#endif
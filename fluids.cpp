@@ -18,9 +18,50 @@ using namespace std;
 #define NRGLYPHSY 8 // For number of glyphs y spinner in glui
 #define NRSLICES 9 // For number of slices spinner in glui
 #define NROPAQUE 10 // For number of opaque spinner in glui
+#define ASYNC 12 // For asynchronous simulation checkbox in glui
+#define STEPRATE 13 // For steps per second spinner in glui
+#define TIMINGCSV 14 // For timing CSV checkbox in glui
+#define TRACE 15 // For trace recording checkbox in glui
+#define RECORDINPUT 16 // For input recording checkbox in glui
+#define SAVECHECKPOINT 17 // For save checkpoint button in glui
+#define LOADCHECKPOINT 18 // For load checkpoint button in glui
+#define RECORDFIELDS 19 // For field recording checkbox in glui
+#define SEEK 20 // For playback frame spinner in glui
+#define SCRUB 21 // For slices back spinner in glui
+#define RESUME 22 // For resume from slice button in glui
+#define EXPORTVTK 23 // For VTK export checkbox in glui
+#define SHAREFIELDS 24 // For shared memory publication checkbox in glui
 
 Simulation Fluids::simulation;      
 Visualization Fluids::visualization;    
+Scheduler Fluids::scheduler;
+SimulationThread Fluids::simulation_thread(Fluids::simulation, Fluids::scheduler);
+int Fluids::async_simulation = 0;
+int Fluids::write_timings = 0;
+int Fluids::record_trace = 0;
+int Fluids::record_input = 0;
+int Fluids::record_fields = 0;
+int Fluids::export_vtk = 0;
+int Fluids::share_fields = 0;
+float Fluids::error_bound = 0;
+InputReplay Fluids::replay;
+bool Fluids::replaying = false;
+double Fluids::replay_start;
+FieldPlayer Fluids::player;
+bool Fluids::playing = false;
+float Fluids::playback_speed = 60;
+int Fluids::seek_frame = 0;
+long Fluids::playback_frame = -1;
+double Fluids::playback_position = 0;
+double Fluids::playback_time = 0;
+const char *Fluids::server = NULL;
+FieldSubscriber Fluids::subscriber;
+CommandQueue Fluids::commands;
+bool Fluids::viewing = false;
+uint64_t Fluids::viewed = 0;
+double Fluids::server_checked = 0;
+bool Fluids::scrubbing = false;
+int Fluids::frozen_before_scrub = 0;
 
 
 int Fluids::winWidth;
@@ -33,6 +74,8 @@ float Fluids::camera_heading;
 
 bool surface_end_point = false;
 Vector2 surface_point;
+int last_mouse_x = 0, last_mouse_y = 0;   //remembers last mouse location, in window coordinates with y up
+long last_shown_input = 0;                //id of the latest mouse event that made it to the screen
 
 const int Fluids::GUI_WIDTH = 200;
 //Spinners in glui
@@ -45,26 +88,172 @@ GLUI_Spinner *clampmax_spinner;
 GLUI_Spinner *glyph_x_spinner;
 GLUI_Spinner *glyph_y_spinner;
 GLUI_Spinner *slices_spinner;
+GLUI_Spinner *keyframe_spinner;
+GLUI_Spinner *scrub_spinner;
 GLUI_Spinner *opaque_spinner;
+GLUI_Spinner *steprate_spinner;
+GLUI_Spinner *brush_spinner;
+GLUI_Spinner *playback_spinner;
+GLUI_Spinner *speed_spinner;
+GLUI_Spinner *error_spinner;
 
 void Fluids::update()
 {
     glutSetWindow(main_window);
-    simulation.do_one_simulation_step();
+    simulation.share_parameters();  // GLUI and the keys edit the parameters in place, the solver steps with a copy
+    if (InputLog::recording()) InputLog::parameters(simulation.step, simulation, visualization);
+    if (viewing) view_step();
+    else if (playing) play_step();
+    else if (replaying) replay_step();
+    else if (!simulation_thread.running())
+    {
+        int steps = scheduler.steps_due();
+        for (int k = 0; k < steps; k++)
+        {
+            simulation.do_one_simulation_step(scheduler.step_time(k));
+            simulation.receive_frame(); // keep a slice of every step
+        }
+    }
+    else if (!simulation.receive_frame() && !simulation.interpolation)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1)); // nothing new to draw yet
     glutPostRedisplay();
 }
 
+//replay_step: Apply the input that is due and do one step, as fast as the display allows. Reports the time the
+//             whole session took when the log runs out, then hands control back to the user.
+void Fluids::replay_step()
+{
+    if (replay.apply(simulation, visualization))
+    {
+        simulation.do_one_simulation_step(Scheduler::now());
+        simulation.receive_frame();
+        return;
+    }
+    double seconds = Scheduler::now() - replay_start;
+    cout << "Replayed " << replay.steps() << " steps in " << seconds << " s (" << replay.steps() / seconds
+         << " steps/s)\n";
+    replaying = false;
+    scheduler.reset();
+    GLUI_Master.sync_live_all();    // the log changed the parameters behind the GUI's back
+}
+
+//play_step: Move the playback position on at the playback speed, in steps per second of the recorded run, and
+//           show the frame it lands on. Stops at either end of the recording.
+void Fluids::play_step()
+{
+    double now = Scheduler::now();
+    playback_position += playback_speed * (now - playback_time) / player.every();
+    playback_position = std::max(0.0, std::min(playback_position, (double)(player.frames() - 1)));
+    playback_time = now;
+
+    long frame = (long)playback_position;
+    if (frame != playback_frame && player.show(frame, simulation))
+    {
+        simulation.receive_frame();
+        playback_frame = frame;
+        playback_spinner->set_int_val(frame);
+    }
+    else std::this_thread::sleep_for(std::chrono::milliseconds(1)); // nothing new to draw yet
+}
+
+//view_step: Show the newest frame of the simulation server, if there is a new one, and send it the parameters
+//           changed here. Looks for a new server every second while it is gone.
+void Fluids::view_step()
+{
+    static double sent[InputLog::GradientDerivative + 1];     //the parameters up to there steer the solver
+    static bool first = true;
+    for (int p = 0; p <= InputLog::GradientDerivative; p++)
+    {
+        double value = InputLog::get(simulation, visualization, p);
+        if (p == InputLog::NumberOfSlices || (!first && value == sent[p])) continue;
+        InputLog::Record record;
+        memset(&record, 0, sizeof(record));
+        record.type = InputLog::Change;
+        record.parameter = p;
+        record.value = value;
+        if (!first) send(record);       //only changes are sent, attaching does not override the other viewers
+        sent[p] = value;
+    }
+    first = false;
+
+    double now = Scheduler::now();
+    if (!subscriber.live() && now - server_checked > 1)
+    {
+        server_checked = now;
+        std::string input = std::string(server) + "-input";
+        if (subscriber.open(server) && subscriber.grid_size() == Simulation::DIM && commands.attach(input.c_str()))
+        {
+            cout << "Attached to " << server << " again\n";
+            viewed = 0;
+        }
+    }
+    if (subscriber.generation() != viewed && subscriber.show(simulation))
+    {
+        viewed = subscriber.generation();
+        simulation.receive_frame();
+    }
+    else std::this_thread::sleep_for(std::chrono::milliseconds(1)); // nothing new to draw yet
+}
+
+//send: Send a record to the simulation server, stamped with the step shown
+void Fluids::send(InputLog::Record &record)
+{
+    record.step = simulation.frame().step;
+    commands.send(record);      //a full lane drops it, the server is not keeping up anyway
+}
+
 
 Fluids::Fluids(int argc, char **argv)
 {
+    int width = 1000, height = 900;
+
     Fluids::usage();
+    Tracer::name_thread("glut");
 
 
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE | GLUT_DEPTH);
 
+    for (int i = 1; i + 1 < argc; i += 2)   // glutInit took out the options of its own
+    {
+        if (!strcmp(argv[i], "--replay"))
+        {
+            if (!replay.load(argv[i + 1])) exit(1);
+            Simulation::DIM = replay.grid_size();
+            width = replay.window_width() + Fluids::GUI_WIDTH;
+            height = replay.window_height();
+            replaying = true;
+        }
+        else if (!strcmp(argv[i], "--play"))
+        {
+            if (!player.open(argv[i + 1]) || !player.frames()) exit(1);
+            Simulation::DIM = player.grid_size();
+            simulation.display_only = true;     // only the frame buffers and slices are used, the solver never steps
+            simulation.init_parameters();
+            playing = true;
+        }
+        else if (!strcmp(argv[i], "--view"))
+        {
+            server = argv[i + 1];
+            std::string input = std::string(server) + "-input";
+            if (!subscriber.open(server) || !commands.attach(input.c_str()))
+            {
+                cout << "No simulation server " << server << ", start one with smoke --serve " << server << "\n";
+                exit(1);
+            }
+            Simulation::DIM = subscriber.grid_size();
+            simulation.display_only = true;     // only the frame buffers and slices are used, the server steps
+            simulation.init_parameters();
+            viewing = true;
+        }
+        else if (!strcmp(argv[i], "--restore"))
+        {
+            if (!Checkpoint::restore(argv[i + 1], simulation)) exit(1);
+        }
+    }
+
     glutInitWindowPosition( 400, 100 );
-    glutInitWindowSize(1000,900);
+    glutInitWindowSize(width,height);
 
     main_window = glutCreateWindow("Real-time smoke simulation and visualization");
 
@@ -85,6 +274,7 @@ Fluids::Fluids(int argc, char **argv)
 
     Fluids::build_gui();
 
+    replay_start = playback_time = Scheduler::now();
     glutMainLoop();         //calls do_one_simulation_step, keyboard, display, drag, reshape
 }
 
@@ -101,16 +291,32 @@ void Fluids::usage()
     // cout << "m:     toggle thru scalar coloring\n";
     cout << "a:     toggle the animation on/off\n";
     cout << "r:     Reset to default parameters\n";
-    cout << "q:     quit\n\n";
+    cout << "q:     quit\n";
+    cout << "Run with --replay FILE to replay an input log recorded with \"Record input\" as fast as possible\n";
+    cout << "Run with --play FILE to play back a field history recorded with \"Record fields\"\n";
+    cout << "Run with --restore FILE to start from a checkpoint saved with \"Save checkpoint\"\n";
+    cout << "Run with --serve NAME [--grid 60] [--rate 60] [--cpus 2,3] to run the solver alone, without a window\n";
+    cout << "Run with --view NAME to attach to such a server and steer it, from any number of viewers\n\n";
 }
 
 void Fluids::reset_values()
 {
+    simulation_thread.stop();   // the solver arrays are reallocated
+    if (InputLog::recording()) InputLog::reset(simulation.step);
+    if (viewing)
+    {
+        InputLog::Record record;
+        memset(&record, 0, sizeof(record));
+        record.type = InputLog::Reset;
+        send(record);
+    }
     simulation.init_parameters();
     visualization.init_parameters();
+    scrubbing = false;
     camera_pitch = 0;
     camera_heading = 0;
     GLUI_Master.sync_live_all();    // sync live variables
+    if (async_simulation) simulation_thread.start();
 
 }
 
@@ -128,6 +334,108 @@ void Fluids::glui_callback( int control )
         case CLAMPMIN: clampmin_spinner->set_float_limits(0,visualization.clamp_max); break;
         case CLAMPMAX: clampmax_spinner->set_float_limits(visualization.clamp_min,10); break;
         case NRSLICES: simulation.number_of_slices = slices_spinner->get_int_val();break;
+        case STEPRATE: // the solver thread reads the schedule, pause it while resetting it
+            simulation_thread.stop();
+            scheduler.reset();
+            if (async_simulation) simulation_thread.start();
+            break;
+        case ASYNC:
+            if (playing || viewing) async_simulation = 0;  // nothing to solve while playing back or viewing
+            if (async_simulation) simulation_thread.start(); else simulation_thread.stop(); break;
+        case TIMINGCSV:
+            if (!write_timings) Profiler::close_csv();
+            else if (Profiler::open_csv("smoke-timings.csv")) cout << "Writing timings to smoke-timings.csv\n";
+            else write_timings = 0;
+            break;
+        case TRACE:
+            if (record_trace) record_trace = Tracer::start();
+            else if (Tracer::stop("smoke-trace.json")) cout << "Wrote trace to smoke-trace.json\n";
+            break;
+        case RECORDINPUT:
+            if (record_input)
+            {
+                reset_values();     // a log starts from the default parameters
+                record_input = InputLog::start("smoke-input.log", Simulation::DIM, winWidth - Fluids::GUI_WIDTH, winHeight);
+                if (record_input) cout << "Recording input to smoke-input.log\n";
+            }
+            else if (InputLog::stop(simulation.step)) cout << "Wrote input log to smoke-input.log\n";
+            break;
+        case SCRUB: // the slices hold still while looking back, the user's Freeze comes back with the latest frame
+            if (playing) break;
+            if (simulation.shown_slice > 0 && !scrubbing)
+            {
+                frozen_before_scrub = simulation.frozen;
+                simulation.frozen = 1;
+                scrubbing = true;
+            }
+            else if (simulation.shown_slice <= 0 && scrubbing)
+            {
+                if (simulation.frozen) simulation.frozen = frozen_before_scrub;    // unless unfrozen meanwhile
+                scrubbing = false;
+            }
+            GLUI_Master.sync_live_all();
+            break;
+        case RESUME:
+            if (playing || viewing || simulation.shown_slice <= 0) break;
+            if (InputLog::recording()) { cout << "Cannot resume from a slice while recording input\n"; break; }
+            simulation_thread.stop();   // the solver takes over the fields of the slice
+            if (simulation.rewind(simulation.slice_count() - 1 - simulation.shown_slice))
+                cout << "Resumed from step " << simulation.step << "\n";
+            else cout << "That slice has no forces, check \"Restartable slices\" to resume from any slice\n";
+            simulation.shown_slice = 0;
+            simulation.frozen = 0;
+            scrubbing = false;
+            scheduler.reset();
+            GLUI_Master.sync_live_all();
+            if (async_simulation) simulation_thread.start();
+            break;
+        case SEEK:
+            playback_position = seek_frame;
+            playback_frame = -1;
+            break;
+        case RECORDFIELDS: // the solver hands over the fields, a viewer has no solver of its own
+            if (viewing) record_fields = 0;
+            if (record_fields)
+            {
+                record_fields = FieldRecorder::start("smoke-fields.rec", Simulation::DIM, 1, error_bound);
+                if (record_fields) cout << "Recording fields to smoke-fields.rec\n";
+            }
+            else if (FieldRecorder::stop()) cout << "Wrote field history to smoke-fields.rec\n";
+            break;
+        case EXPORTVTK: // with the derivative fields the solver is computing
+            if (viewing) export_vtk = 0;
+            if (export_vtk)
+            {
+                export_vtk = VtkExporter::start("smoke-export.pvd", Simulation::DIM, 1, true);
+                if (export_vtk) cout << "Exporting fields to smoke-export.pvd\n";
+            }
+            else if (VtkExporter::stop()) cout << "Wrote smoke-export.pvd\n";
+            break;
+        case SHAREFIELDS:
+            if (viewing) share_fields = 0;  // the server shares them already
+            if (share_fields)
+            {
+                share_fields = FieldPublisher::start("/smoke-fields", Simulation::DIM);
+                if (share_fields) cout << "Publishing fields to /dev/shm/smoke-fields\n";
+            }
+            else FieldPublisher::stop();
+            break;
+        case SAVECHECKPOINT: // the solver must not write the fields while they are saved
+            if (playing) { cout << "Nothing to save, the solver does not run while playing back\n"; break; }
+            if (viewing) { cout << "Nothing to save, the solver runs in the server\n"; break; }
+            simulation_thread.stop();
+            if (Checkpoint::save("smoke-checkpoint.bin", simulation, error_bound)) cout << "Saved checkpoint to smoke-checkpoint.bin\n";
+            else cout << "Cannot write smoke-checkpoint.bin\n";
+            if (async_simulation) simulation_thread.start();
+            break;
+        case LOADCHECKPOINT:
+            if (playing) { cout << "Cannot load a checkpoint while playing back\n"; break; }
+            if (viewing) { cout << "Cannot load a checkpoint into the server from a viewer\n"; break; }
+            simulation_thread.stop();
+            if (Checkpoint::restore("smoke-checkpoint.bin", simulation)) cout << "Restored smoke-checkpoint.bin\n";
+            GLUI_Master.sync_live_all();
+            if (async_simulation) simulation_thread.start();
+            break;
     }
 
   
@@ -145,14 +453,45 @@ void Fluids::build_gui()
     glui->add_checkbox_to_panel(options_panel, "Scaling", &visualization.options[Visualization::Scaling] );
     glui->add_checkbox_to_panel(options_panel, "Draw slices", &visualization.options[Visualization::Slices] );
     glui->add_checkbox_to_panel(options_panel, "Freeze", &simulation.frozen );
+    if (!viewing)   // the controls of the local solver, a viewer only shows the server's
+        glui->add_checkbox_to_panel(options_panel, "Async simulation", &async_simulation, ASYNC, glui_callback );
+    glui->add_checkbox_to_panel(options_panel, "Interpolate frames", &simulation.interpolation );
+    glui->add_checkbox_to_panel(options_panel, "Show timings", &visualization.options[Visualization::Timings] );
+    glui->add_checkbox_to_panel(options_panel, "Write timings CSV", &write_timings, TIMINGCSV, glui_callback );
+    glui->add_checkbox_to_panel(options_panel, "Record trace", &record_trace, TRACE, glui_callback );
+    glui->add_checkbox_to_panel(options_panel, "Record input", &record_input, RECORDINPUT, glui_callback );
+    if (!viewing)
+    {
+        glui->add_checkbox_to_panel(options_panel, "Record fields", &record_fields, RECORDFIELDS, glui_callback );
+        glui->add_checkbox_to_panel(options_panel, "Export VTK", &export_vtk, EXPORTVTK, glui_callback );
+        glui->add_checkbox_to_panel(options_panel, "Share fields", &share_fields, SHAREFIELDS, glui_callback );
+    }
     options_panel->set_w(Fluids::GUI_WIDTH);
 
+    //Error bound spinner for the field recording and the checkpoint slices, 0 stores them exactly
+    error_spinner = glui->add_spinner("Error bound",GLUI_SPINNER_FLOAT , &error_bound );
+    error_spinner->set_speed(0.0001);
+    error_spinner->set_float_limits(0,1);
+    error_spinner->set_float_val(error_bound);
+
     //Time step spinner
     timestep_spinner = glui->add_spinner("Time Step",GLUI_SPINNER_FLOAT , &simulation.dt, TIMESTEP, glui_callback );
     timestep_spinner->set_speed(0.001); 
     timestep_spinner->set_float_limits(0,100);
     timestep_spinner->set_float_val(simulation.dt);
 
+    //Simulation rate spinner, 0 steps the simulation once per redisplay
+    steprate_spinner = glui->add_spinner("Steps per second",GLUI_SPINNER_FLOAT , &scheduler.steps_per_second, STEPRATE, glui_callback );
+    steprate_spinner->set_speed(1); 
+    steprate_spinner->set_float_limits(0,1000);
+    steprate_spinner->set_float_val(scheduler.steps_per_second);
+
+    //Brush radius spinner, in grid cells
+    brush_spinner = glui->add_spinner("Brush radius",GLUI_SPINNER_FLOAT , &simulation.brush_radius );
+    brush_spinner->set_speed(0.1); 
+    brush_spinner->set_float_limits(0,Simulation::DIM/4);
+    brush_spinner->set_float_val(simulation.brush_radius);
+
     //Hedgehog scale spinner
     hedgehog_spinner = glui->add_spinner("Hedgehog Scale",GLUI_SPINNER_FLOAT , &visualization.vec_scale, HEDGEHOGSCALE, glui_callback );
     hedgehog_spinner->set_speed(1); 
@@ -193,6 +532,13 @@ void Fluids::build_gui()
     glui->add_radiobutton_to_group(scalar_radio, "Density (Rho)");
     glui->add_radiobutton_to_group(scalar_radio, "Velocity (vx,vy)");
     glui->add_radiobutton_to_group(scalar_radio, "Force (fx, fy)");
+    glui->add_radiobutton_to_group(scalar_radio, "Vorticity");
+    glui->add_radiobutton_to_group(scalar_radio, "Divergence");
+
+    GLUI_Panel *derivative_panel = glui->add_panel("Spectral derivatives"); 
+    glui->add_checkbox_to_panel(derivative_panel, "Vorticity", &simulation.derivatives[Simulation::Vorticity] );
+    glui->add_checkbox_to_panel(derivative_panel, "Divergence", &simulation.derivatives[Simulation::Divergence] );
+    glui->add_checkbox_to_panel(derivative_panel, "Density gradient", &simulation.derivatives[Simulation::DensityGradient] );
 
     GLUI_Panel *vector_panel = glui->add_panel("Vector field"); 
     GLUI_RadioGroup *vector_radio = glui->add_radiogroup_to_panel(vector_panel, &visualization.selected_vector);
@@ -220,9 +566,27 @@ void Fluids::build_gui()
 
     slices_spinner = glui->add_spinner("Number of slices", GLUI_SPINNER_INT, &simulation.number_of_slices, NRSLICES, glui_callback );   
     slices_spinner->set_speed(1); 
-    slices_spinner->set_int_limits(20,50);
+    slices_spinner->set_int_limits(20,Simulation::MAX_SLICES);
     slices_spinner->set_int_val(20);
 
+    //Keyframe interval spinner, 0 keeps every slice instead of rebuilding them from keyframes.
+    //Not when playing back or viewing: there is no solver here to rebuild the slices with.
+    if (!playing && !viewing)
+    {
+        keyframe_spinner = glui->add_spinner("Keyframe every", GLUI_SPINNER_INT, &simulation.keyframe_interval );
+        keyframe_spinner->set_speed(1);
+        keyframe_spinner->set_int_limits(0,Simulation::MAX_KEYFRAME_INTERVAL);
+        keyframe_spinner->set_int_val(simulation.keyframe_interval);
+    }
+
+    //Time travel: look back at a slice, and resume the simulation from it
+    GLUI_Panel *travel_panel = glui->add_panel("Time travel");
+    glui->add_checkbox_to_panel(travel_panel, "Restartable slices", &simulation.restartable_slices );
+    scrub_spinner = glui->add_spinner_to_panel(travel_panel, "Slices back", GLUI_SPINNER_INT, &simulation.shown_slice, SCRUB, glui_callback );
+    scrub_spinner->set_speed(1);
+    scrub_spinner->set_int_limits(0, Simulation::MAX_SLICES - 1);
+    if (!viewing) glui->add_button_to_panel(travel_panel, "Resume from slice", RESUME, glui_callback );
+
     opaque_spinner = glui->add_spinner("Opacity", GLUI_SPINNER_FLOAT, &visualization.number_of_opaque, NROPAQUE, glui_callback );   
     opaque_spinner->set_speed(0.2); 
     opaque_spinner->set_float_limits(0,1);
@@ -233,7 +597,24 @@ void Fluids::build_gui()
     glui->add_radiobutton_to_group(stream_radio, "Lines");
     glui->add_radiobutton_to_group(stream_radio, "Surfaces");
 
+    if (playing)
+    {
+        //Playback frame and speed spinners, a negative speed plays backwards
+        GLUI_Panel *playback_panel = glui->add_panel("Playback");
+        playback_spinner = glui->add_spinner_to_panel(playback_panel, "Frame", GLUI_SPINNER_INT, &seek_frame, SEEK, glui_callback );
+        playback_spinner->set_speed(1);
+        playback_spinner->set_int_limits(0, player.frames() - 1);
+        speed_spinner = glui->add_spinner_to_panel(playback_panel, "Steps per second", GLUI_SPINNER_FLOAT, &playback_speed );
+        speed_spinner->set_speed(1);
+        speed_spinner->set_float_limits(-1000, 1000);
+        speed_spinner->set_float_val(playback_speed);
+    }
 
+    if (!viewing)
+    {
+        new GLUI_Button( glui, "Save checkpoint", SAVECHECKPOINT, glui_callback );
+        new GLUI_Button( glui, "Load checkpoint", LOADCHECKPOINT, glui_callback );
+    }
     new GLUI_Button( glui, "Reset", RESET_VALUES, glui_callback ); //Reset button
     new GLUI_Button( glui, "Quit", 0,(GLUI_Update_CB)exit ); //Quit button
 }
@@ -292,6 +673,7 @@ void Fluids::move_camera(int key, int x, int y)
 //display: Handle window redrawing events. Simply delegates to visualize().
 void Fluids::display(void)
 {
+    Profiler::Timer timer(Profiler::Frame);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
@@ -303,9 +685,27 @@ void Fluids::display(void)
     glRotatef(camera_pitch, 0, 1, 0);
     glRotatef(camera_heading, 1, 0, 0);
     glTranslatef(-(winWidth-Fluids::GUI_WIDTH)/2,-winHeight/2,0);
-    visualization.visualize(simulation, winWidth, winHeight);
+    simulation.publish_forces = visualization.shows_forces();
+    simulation.interpolate(Scheduler::now() - scheduler.period());
+    {
+        AllocStats::Scope scope(AllocStats::Render);
+        visualization.visualize(simulation, winWidth, winHeight);
+    }
     glFlush();
     glutSwapBuffers();
+    FieldSet const &shown = simulation.frame();
+    if (shown.input > last_shown_input) // mouse input reached the screen
+    {
+        double now = Scheduler::now();
+        Profiler::sample(Profiler::InputLatency, (now - shown.input_time) * 1000);
+        if (Tracer::recording())
+            for (long id = max(last_shown_input + 1, shown.input - 63); id <= shown.input; id++)
+                Tracer::flow('f', "input", id, now);
+        last_shown_input = shown.input;
+    }
+    timer.stop();
+    Profiler::end_frame();
+    AllocStats::end_frame();
 
 }
 
@@ -326,35 +726,47 @@ void Fluids::reshape(int w, int h)
 }
 
 
+// to_grid: Map a window coordinate along an axis of 'size' pixels to a grid coordinate, in cells
+static float to_grid(int pixel, int size)
+{
+    return clamp((Simulation::DIM + 1) * ((float)pixel / (float)size) - 0.5f, 0, Simulation::DIM - 1);
+}
+
 // drag: When the user drags with the mouse, add a force that corresponds to the direction of the mouse
-//       cursor movement. Also inject some new matter into the field at the mouse location.
+//       cursor movement. Also inject some new matter into the field along the path of the mouse.
 void Fluids::drag(int mx, int my)
 {
-    int xi,yi,X,Y; double  dx, dy, len;
-    static int lmx=0,lmy=0;             //remembers last mouse location
-
-    // Compute the array index that corresponds to the cursor location
-    xi = (int)clamp((double)(Simulation::DIM + 1) * ((double)mx / (double)(winWidth-Fluids::GUI_WIDTH)));
-    yi = (int)clamp((double)(Simulation::DIM + 1) * ((double)(winHeight - my) / (double)winHeight));
-
-    X = xi; Y = yi;
-
-    if (X > (Simulation::DIM - 1))  X = Simulation::DIM - 1; if (Y > (Simulation::DIM - 1))  Y = Simulation::DIM - 1;
-    if (X < 0) X = 0; if (Y < 0) Y = 0;
+    double  dx, dy, len;
 
-    // Add force at the cursor location
+    // Add force along the path from the last cursor location
     my = winHeight - my;
-    dx = mx - lmx; dy = my - lmy;
+    dx = mx - last_mouse_x; dy = my - last_mouse_y;
     len = sqrt(dx * dx + dy * dy);
     if (len != 0.0) {  dx *= 0.1 / len; dy *= 0.1 / len; }
 
-    simulation.insert_forces(X, Y, dx, dy);
+    if (viewing)   // the server applies it
+    {
+        InputLog::Record record;
+        memset(&record, 0, sizeof(record));
+        record.type = InputLog::Force;
+        record.force.x0 = to_grid(last_mouse_x, winWidth-Fluids::GUI_WIDTH); record.force.y0 = to_grid(last_mouse_y, winHeight);
+        record.force.x1 = to_grid(mx, winWidth-Fluids::GUI_WIDTH); record.force.y1 = to_grid(my, winHeight);
+        record.force.dx = dx; record.force.dy = dy;
+        send(record);
+    }
+    else simulation.insert_forces(to_grid(last_mouse_x, winWidth-Fluids::GUI_WIDTH), to_grid(last_mouse_y, winHeight),
+                                  to_grid(mx, winWidth-Fluids::GUI_WIDTH), to_grid(my, winHeight), dx, dy);
     
-    lmx = mx; lmy = my;
+    last_mouse_x = mx; last_mouse_y = my;
 }
 
 void Fluids::click(int button, int state, int mx, int my)
 {
+    if (button == GLUT_LEFT_BUTTON && state==GLUT_DOWN) // start a new mouse path
+    {
+        last_mouse_x = mx;
+        last_mouse_y = winHeight-my;
+    }
 
     if (button == GLUT_RIGHT_BUTTON && state==GLUT_DOWN)
     {
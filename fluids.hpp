@@ -3,11 +3,20 @@
 #include <iostream>
 #include <rfftw.h>              //the numerical simulation FFTW library
 #include <stdio.h>              //for printing the help text
+#include <string.h>
 
+#include "checkpoint.hpp"
+#include "commandqueue.hpp"
+#include "fieldplayer.hpp"
+#include "fieldpublisher.hpp"
+#include "fieldrecorder.hpp"
+#include "fieldsubscriber.hpp"
+#include "inputlog.hpp"
 #include "simulation.hpp"
-#include "util.hpp"
+#include "simulationthread.hpp"
 #include "vector2.hpp"
 #include "visualization.hpp"
+#include "vtkexporter.hpp"
 
 class Fluids
 {
@@ -18,8 +27,40 @@ public:
 private:
 	static Simulation simulation;
 	static Visualization visualization;
+	static Scheduler scheduler;
+	static SimulationThread simulation_thread;
+	static int async_simulation;		//run the solver on its own thread or not
+	static int write_timings;			//write the phase timings to a CSV file or not
+	static int record_trace;			//record a trace of all phases or not
+	static int record_input;			//record the input to smoke-input.log or not
+	static int record_fields;			//record the field history to smoke-fields.rec or not
+	static int export_vtk;				//export the fields to smoke-export.pvd for ParaView or not
+	static int share_fields;			//publish the fields to the shared memory object /smoke-fields or not
+	static float error_bound;			//of the field recording and the checkpoint slices, 0 for lossless
+	static InputReplay replay;			//input log given with --replay
+	static bool replaying;				//replaying the log instead of taking input
+	static double replay_start;			//wall-clock time the replay started
+	static FieldPlayer player;			//field history given with --play
+	static bool playing;				//playing the history back instead of simulating
+	static float playback_speed;		//in steps of the recorded run per second, negative plays backwards
+	static int seek_frame;				//frame the playback spinner asks for
+	static long playback_frame;			//frame shown, -1 for none
+	static double playback_position;	//in frames, moves on with the playback speed
+	static double playback_time;		//wall-clock time the position was last moved
+	static const char *server;			//shared memory name of the simulation server given with --view
+	static FieldSubscriber subscriber;	//fields of that server
+	static CommandQueue commands;		//input to that server
+	static bool viewing;				//showing the server's fields instead of simulating
+	static uint64_t viewed;				//generation of the server's frame shown last
+	static double server_checked;		//wall-clock time the server was last looked for
+	static bool scrubbing;				//looking back at a slice, with the solver frozen for it
+	static int frozen_before_scrub;		//Freeze as the user had it before looking back
 	static const int GUI_WIDTH;
 	static void update(void);
+	static void replay_step();
+	static void play_step();
+	static void view_step();
+	static void send(InputLog::Record &record);
 	static void usage();
 	static void build_gui();
 	static void myGlutIdle( void );
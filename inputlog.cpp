@@ -0,0 +1,315 @@
+#include "inputlog.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include "simulation.hpp"
+#include "visualization.hpp"
+
+using namespace std;
+
+const char InputLog::MAGIC[8] = {'S', 'M', 'O', 'K', 'E', 'I', 'N', 'P'};
+
+// File layout: MAGIC, VERSION, then the grid size and the drawing area (in pixels, the seed points are in window
+// coordinates) as int32, followed by fixed-size Records until the End record.
+struct Header
+{
+      char magic[8];
+      uint32_t version;
+      int32_t n, width, height;
+};
+
+static FILE *file = NULL;
+static mutex file_mutex;                         //forces come from the solver thread, everything else from GLUT
+static atomic<bool> active(false);
+static double logged[InputLog::ParameterSize];   //parameter values as last written to the log
+static uint32_t last_step = 0;                   //step of the record written last, since the last reset
+
+
+//--- RECORDING ----------------------------------------------------------------------------------------------------
+
+//write: Append a record. The GLUT thread reads the solver's step while the solver may be finishing it, so a
+//       record can race a force of the next step to the file; it takes that force's step then, and the steps
+//       in the log never go backwards until the next reset.
+static void write(InputLog::Record &record)
+{
+      lock_guard<mutex> lock(file_mutex);
+      if (record.step < last_step) record.step = last_step;
+      last_step = record.type == InputLog::Reset ? 0 : record.step;
+      if (file) fwrite(&record, sizeof(record), 1, file);
+}
+
+static InputLog::Record make(InputLog::Type type, long step)
+{
+      InputLog::Record record;
+      memset(&record, 0, sizeof(record));       //no stray bytes in the file, so equal sessions give equal logs
+      record.type = type;
+      record.step = step;
+      return record;
+}
+
+//start: Start a log for a session on an n*n grid, drawn in a width*height area. The session is expected to
+//       start from the default parameters; the log begins with a Reset so replays start from them as well.
+bool InputLog::start(const char *path, int n, int width, int height)
+{
+      Header header;
+      FILE *out = fopen(path, "wb");
+      if (!out) return false;
+
+      memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = VERSION;
+      header.n = n;
+      header.width = width;
+      header.height = height;
+      fwrite(&header, sizeof(header), 1, out);
+      for (int p = 0; p < ParameterSize; p++) logged[p] = NAN;    //the first poll writes all parameters
+      {
+            lock_guard<mutex> lock(file_mutex);
+            file = out;
+            last_step = 0;
+      }
+      active = true;
+      reset(0);
+      return true;
+}
+
+//stop: End the log after 'step' steps and close it. Returns false if the log could not be written completely.
+bool InputLog::stop(long step)
+{
+      Record record = make(End, step);
+      bool ok;
+
+      if (!active) return false;
+      active = false;
+      write(record);
+      lock_guard<mutex> lock(file_mutex);
+      ok = !ferror(file);
+      ok = fclose(file) == 0 && ok;
+      file = NULL;
+      return ok;
+}
+
+bool InputLog::recording()
+{
+      return active;
+}
+
+//force: Log a mouse event, as the solver applies it at the start of step 'step' + 1
+void InputLog::force(long step, InputEvent const &event)
+{
+      Record record = make(Force, step);
+      record.force.x0 = event.x0;
+      record.force.y0 = event.y0;
+      record.force.x1 = event.x1;
+      record.force.y1 = event.y1;
+      record.force.dx = event.dx;
+      record.force.dy = event.dy;
+      write(record);
+}
+
+void InputLog::seedpoint(long step, Vector2 point)
+{
+      Record record = make(Seedpoint, step);
+      record.points.x0 = point.x;
+      record.points.y0 = point.y;
+      write(record);
+}
+
+void InputLog::streamsurface(long step, Vector2 p1, Vector2 p2)
+{
+      Record record = make(StreamSurface, step);
+      record.points.x0 = p1.x;
+      record.points.y0 = p1.y;
+      record.points.x1 = p2.x;
+      record.points.y1 = p2.y;
+      write(record);
+}
+
+//reset: Log a reset to the default parameters. The parameters are logged again by the next poll.
+void InputLog::reset(long step)
+{
+      Record record = make(Reset, step);
+      write(record);
+}
+
+//parameters: Log every parameter that changed since the last poll. Polling, rather than hooking every spinner,
+//            key and checkbox, also catches the GUI's live variables, which change without any callback.
+void InputLog::parameters(long step, Simulation const &simulation, Visualization const &visualization)
+{
+      for (int p = 0; p < ParameterSize; p++)
+      {
+            double value = get(simulation, visualization, p);
+            if (value == logged[p]) continue;
+            Record record = make(Change, step);
+            record.parameter = p;
+            record.value = value;
+            write(record);
+            logged[p] = value;
+      }
+}
+
+double InputLog::get(Simulation const &simulation, Visualization const &visualization, int parameter)
+{
+      switch (parameter)
+      {
+            case Timestep: return simulation.dt;
+            case Viscosity: return simulation.visc;
+            case BrushRadius: return simulation.brush_radius;
+            case NumberOfSlices: return simulation.number_of_slices;
+            case VorticityDerivative: return simulation.derivatives[Simulation::Vorticity];
+            case DivergenceDerivative: return simulation.derivatives[Simulation::Divergence];
+            case GradientDerivative: return simulation.derivatives[Simulation::DensityGradient];
+            case DrawSmoke: return visualization.options[Visualization::DrawSmoke];
+            case DrawVecs: return visualization.options[Visualization::DrawVecs];
+            case Scaling: return visualization.options[Visualization::Scaling];
+            case Slices: return visualization.options[Visualization::Slices];
+            case Timings: return visualization.options[Visualization::Timings];
+            case ScalarField: return visualization.selected_scalar;
+            case VectorField: return visualization.selected_vector;
+            case GlyphType: return visualization.selected_glyph;
+            case GlyphsX: return visualization.number_of_glyphs_x;
+            case GlyphsY: return visualization.number_of_glyphs_y;
+            case StreamType: return visualization.selected_stream;
+            case HedgehogScale: return visualization.vec_scale;
+            case Colormap: return visualization.selected_colormap;
+            case NumberOfColors: return visualization.number_of_colors;
+            case ClampMin: return visualization.clamp_min;
+            case ClampMax: return visualization.clamp_max;
+            case Opaque: return visualization.number_of_opaque;
+      }
+      return 0;
+}
+
+void InputLog::set(Simulation &simulation, Visualization &visualization, int parameter, double value)
+{
+      switch (parameter)
+      {
+            case Timestep: simulation.dt = value; break;
+            case Viscosity: simulation.visc = value; break;
+            case BrushRadius: simulation.brush_radius = value; break;
+            case NumberOfSlices: simulation.number_of_slices = value; break;
+            case VorticityDerivative: simulation.derivatives[Simulation::Vorticity] = value; break;
+            case DivergenceDerivative: simulation.derivatives[Simulation::Divergence] = value; break;
+            case GradientDerivative: simulation.derivatives[Simulation::DensityGradient] = value; break;
+            case DrawSmoke: visualization.options[Visualization::DrawSmoke] = value; break;
+            case DrawVecs: visualization.options[Visualization::DrawVecs] = value; break;
+            case Scaling: visualization.options[Visualization::Scaling] = value; break;
+            case Slices: visualization.options[Visualization::Slices] = value; break;
+            case Timings: visualization.options[Visualization::Timings] = value; break;
+            case ScalarField: visualization.selected_scalar = value; break;
+            case VectorField: visualization.selected_vector = value; break;
+            case GlyphType: visualization.selected_glyph = value; break;
+            case GlyphsX: visualization.number_of_glyphs_x = value; break;
+            case GlyphsY: visualization.number_of_glyphs_y = value; break;
+            case StreamType: visualization.selected_stream = value; break;
+            case HedgehogScale: visualization.vec_scale = value; break;
+            case Colormap: visualization.selected_colormap = value; break;
+            case NumberOfColors: visualization.number_of_colors = value; break;
+            case ClampMin: visualization.clamp_min = value; break;
+            case ClampMax: visualization.clamp_max = value; break;
+            case Opaque: visualization.number_of_opaque = value; break;
+      }
+      simulation.publish_forces = visualization.shows_forces();
+}
+
+
+//--- REPLAY -------------------------------------------------------------------------------------------------------
+
+InputReplay::InputReplay() : position(0), n(0), width(0), height(0)
+{
+}
+
+//load: Read a complete log. Returns false if 'path' is not an input log, or if it was cut short.
+bool InputReplay::load(const char *path)
+{
+      Header header;
+      InputLog::Record record;
+      FILE *in = fopen(path, "rb");
+      if (!in) return false;
+
+      records.clear();
+      position = 0;
+      bool ok = fread(&header, sizeof(header), 1, in) == 1 &&
+                !memcmp(header.magic, InputLog::MAGIC, sizeof(InputLog::MAGIC)) && header.version == InputLog::VERSION;
+      while (ok && fread(&record, sizeof(record), 1, in) == 1)
+      {
+            records.push_back(record);
+            if (record.type == InputLog::End) break;
+      }
+      fclose(in);
+      ok = ok && !records.empty() && records.back().type == InputLog::End;
+      if (!ok)
+      {
+            fprintf(stderr, "%s is not a complete input log\n", path);
+            records.clear();
+            return false;
+      }
+      n = header.n;
+      width = header.width;
+      height = header.height;
+      return true;
+}
+
+//apply: Apply every record that is due before the next step of 'simulation'. Forces go through the input queue
+//       like the mouse's, so they are splatted by the step that applied them in the recorded session.
+//       Returns false once the session is over.
+bool InputReplay::apply(Simulation &simulation, Visualization &visualization)
+{
+      while (position < records.size() && records[position].step <= (uint32_t)simulation.step)
+      {
+            InputLog::Record const &record = records[position++];
+            switch (record.type)
+            {
+                  case InputLog::Force:
+                        simulation.insert_forces(record.force.x0, record.force.y0, record.force.x1, record.force.y1,
+                                                 record.force.dx, record.force.dy);
+                        break;
+                  case InputLog::Seedpoint:
+                        simulation.add_seedpoint(Vector2(record.points.x0, record.points.y0));
+                        break;
+                  case InputLog::StreamSurface:
+                        simulation.add_streamsurface(Vector2(record.points.x0, record.points.y0),
+                                                     Vector2(record.points.x1, record.points.y1));
+                        break;
+                  case InputLog::Change:
+                        InputLog::set(simulation, visualization, record.parameter, record.value);
+                        break;
+                  case InputLog::Reset:
+                        Simulation::DIM = n;
+                        simulation.init_parameters();
+                        visualization.init_parameters();
+                        break;
+            }
+      }
+      simulation.share_parameters();
+      return !done();
+}
+
+bool InputReplay::done() const
+{
+      return position >= records.size();
+}
+
+//steps: Number of steps in the session, counted from its last reset
+long InputReplay::steps() const
+{
+      return records.empty() ? 0 : records.back().step;
+}
+
+int InputReplay::grid_size() const
+{
+      return n;
+}
+
+int InputReplay::window_width() const
+{
+      return width;
+}
+
+int InputReplay::window_height() const
+{
+      return height;
+}
@@ -0,0 +1,114 @@
+#ifndef INPUTLOG_HPP
+#define INPUTLOG_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "vector2.hpp"
+
+class Simulation;
+class Visualization;
+struct InputEvent;
+
+// Compact binary log of everything that steers a session: the mouse forces, seed points, stream surfaces, resets
+// and every parameter the GUI changes, each stamped with the number of simulation steps done before it took
+// effect. InputLog records a session; InputReplay plays a log back against a Simulation and Visualization, so the
+// same workload can be run again as fast as possible, with or without drawing it.
+class InputLog
+{
+
+
+public:
+	enum Type
+	{
+		Force,				//a mouse event, as applied by the solver
+		Seedpoint,			//a streamline seed point
+		StreamSurface,		//a stream surface between two points
+		Change,				//a parameter changed to a new value
+		Reset,				//back to the default parameters
+		End					//end of the session
+	};
+
+	enum Parameter
+	{
+		Timestep,
+		Viscosity,
+		BrushRadius,
+		NumberOfSlices,
+		VorticityDerivative,
+		DivergenceDerivative,
+		GradientDerivative,
+		DrawSmoke,
+		DrawVecs,
+		Scaling,
+		Slices,
+		Timings,
+		ScalarField,
+		VectorField,
+		GlyphType,
+		GlyphsX,
+		GlyphsY,
+		StreamType,
+		HedgehogScale,
+		Colormap,
+		NumberOfColors,
+		ClampMin,
+		ClampMax,
+		Opaque,
+		ParameterSize		//auto assigned (last in enum==size of enum)
+	};
+
+	struct Record
+	{
+		uint8_t type;
+		uint8_t parameter;
+		uint16_t reserved;
+		uint32_t step;				//simulation steps done before the record took effect
+		union
+		{
+			struct { float x0, y0, x1, y1; double dx, dy; } force;
+			struct { float x0, y0, x1, y1; } points;	//seed point (x0,y0) or stream surface
+			double value;
+		};
+	};
+
+	static bool start(const char *path, int n, int width, int height);
+	static bool stop(long step);
+	static bool recording();
+	static void force(long step, InputEvent const &event);
+	static void seedpoint(long step, Vector2 point);
+	static void streamsurface(long step, Vector2 p1, Vector2 p2);
+	static void reset(long step);
+	static void parameters(long step, Simulation const &simulation, Visualization const &visualization);
+
+	static double get(Simulation const &simulation, Visualization const &visualization, int parameter);
+	static void set(Simulation &simulation, Visualization &visualization, int parameter, double value);
+
+	static const char MAGIC[8];
+	static const uint32_t VERSION = 1;
+
+};
+
+class InputReplay
+{
+
+
+public:
+	InputReplay();
+	bool load(const char *path);
+	bool apply(Simulation &simulation, Visualization &visualization);
+	bool done() const;
+	long steps() const;
+	int grid_size() const;
+	int window_width() const;
+	int window_height() const;
+
+private:
+	std::vector<InputLog::Record> records;
+	size_t position;			//next record to apply
+	int n;						//grid size of the recorded session
+	int width, height;			//drawing area of the recorded session, in pixels
+
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "fluids.hpp"
+#include "simulationserver.hpp"
 
 
 /*TODO:
@@ -10,6 +11,7 @@
 //main: The main program
 int main(int argc, char **argv)
 {
+	if (SimulationServer::wanted(argc, argv)) return SimulationServer(argc, argv).run();   //no window
 	new Fluids(argc, argv);
 	return 0;
 }
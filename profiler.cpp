@@ -0,0 +1,142 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+#include "tracer.hpp"
+
+using namespace std;
+
+const char *Profiler::names[Profiler::PhaseSize] = {"step", "set_forces", "advection", "fft", "projection", "derivatives",
+      "diffuse_matter", "frame", "slice_capture", "smoke", "glyphs", "streamlines", "surfaces", "legend", "input_latency"};
+
+static atomic<long> pending[Profiler::PhaseSize];                      //time spent in the current step or frame, in ns
+static atomic<long> total[Profiler::PhaseSize];                        //time spent since startup, in ns
+static atomic<float> samples[Profiler::PhaseSize][Profiler::WINDOW];   //last samples, in ms
+static atomic<unsigned> taken[Profiler::PhaseSize];                    //number of samples taken
+
+static FILE *csv = NULL;                                               //CSV output, GLUT thread only
+static long written[Profiler::PhaseSize];                              //totals at the last CSV row
+static long rows = 0;
+
+Profiler::Timer::Timer(Phase phase) : phase(phase), start(chrono::steady_clock::now())
+{
+}
+
+Profiler::Timer::~Timer()
+{
+      stop();
+}
+
+//next: End the current phase and time 'phase' from here on
+void Profiler::Timer::next(Phase phase)
+{
+      chrono::steady_clock::time_point now = chrono::steady_clock::now();
+      if (this->phase != PhaseSize)
+      {
+            add(this->phase, chrono::duration_cast<chrono::nanoseconds>(now - start).count());
+            if (Tracer::recording())
+                  Tracer::span(names[this->phase], chrono::duration<double>(start.time_since_epoch()).count(),
+                               chrono::duration<double>(now.time_since_epoch()).count());
+      }
+      this->phase = phase;
+      start = now;
+}
+
+//stop: End the current phase before the end of the scope
+void Profiler::Timer::stop()
+{
+      next(PhaseSize);
+}
+
+void Profiler::add(Phase phase, long nanoseconds)
+{
+      pending[phase].fetch_add(nanoseconds, memory_order_relaxed);
+      total[phase].fetch_add(nanoseconds, memory_order_relaxed);
+}
+
+//sample: Add a measurement of 'milliseconds' that is not timed by a Timer, like the input latency
+void Profiler::sample(Phase phase, float milliseconds)
+{
+      unsigned k = taken[phase].load(memory_order_relaxed);
+      samples[phase][k % Profiler::WINDOW].store(milliseconds, memory_order_relaxed);
+      taken[phase].store(k + 1, memory_order_release);
+      total[phase].fetch_add((long)(milliseconds * 1e6), memory_order_relaxed);
+}
+
+//commit: Turn the pending time of the phases first..last into one sample each. Each phase is only committed by
+//        the thread that times it, so the sample slots have a single writer.
+static void commit(int first, int last)
+{
+      for (int p = first; p <= last; p++)
+      {
+            long ns = pending[p].exchange(0, memory_order_relaxed);
+            unsigned k = taken[p].load(memory_order_relaxed);
+            samples[p][k % Profiler::WINDOW].store(ns * 1e-6f, memory_order_relaxed);
+            taken[p].store(k + 1, memory_order_release);
+      }
+}
+
+//end_step: Called by the thread running the solver after every step
+void Profiler::end_step()
+{
+      commit(Step, DiffuseMatter);
+}
+
+//end_frame: Called by the GLUT thread after every displayed frame; also writes the CSV row of the frame
+void Profiler::end_frame()
+{
+      commit(Frame, Legend);
+      if (!csv) return;
+
+      fprintf(csv, "%ld", rows++);
+      for (int p = 0; p < PhaseSize; p++)
+      {
+            long t = total[p].load(memory_order_relaxed);
+            fprintf(csv, ",%.4f", (t - written[p]) * 1e-6);  //ms spent in the phase since the previous row
+            written[p] = t;
+      }
+      fprintf(csv, "\n");
+}
+
+//summary: Average and 99th percentile, in ms, of the last WINDOW samples of 'phase'
+void Profiler::summary(Phase phase, float *average, float *p99)
+{
+      float window[WINDOW];
+      unsigned k = taken[phase].load(memory_order_acquire);
+      int n = (int)min(k, (unsigned)WINDOW);
+      float sum = 0;
+
+      *average = *p99 = 0;
+      if (!n) return;
+      for (int i = 0; i < n; i++)
+      {
+            window[i] = samples[phase][i].load(memory_order_relaxed);
+            sum += window[i];
+      }
+      int rank = min(n - 1, (int)(0.99f * n));
+      nth_element(window, window + rank, window + n);
+      *average = sum / n;
+      *p99 = window[rank];
+}
+
+//open_csv: Start writing a row per frame to 'path', with the ms spent in every phase since the previous row
+bool Profiler::open_csv(const char *path)
+{
+      close_csv();
+      csv = fopen(path, "w");
+      if (!csv) return false;
+
+      fprintf(csv, "frame");
+      for (int p = 0; p < PhaseSize; p++) fprintf(csv, ",%s_ms", names[p]);
+      fprintf(csv, "\n");
+      for (int p = 0; p < PhaseSize; p++) written[p] = total[p].load(memory_order_relaxed);
+      rows = 0;
+      return true;
+}
+
+void Profiler::close_csv()
+{
+      if (csv) fclose(csv);
+      csv = NULL;
+}
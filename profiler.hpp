@@ -0,0 +1,62 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <chrono>
+#include <cstdio>
+
+// Per-phase timing of the simulation and the visualization. Timers add the time spent in a phase to the phase's
+// running total; end_step() and end_frame() turn the totals of the step or frame that just ended into one sample
+// each. The last WINDOW samples of every phase give the rolling average and 99th percentile shown in the timing
+// overlay, and every frame can be written as a row of a CSV file.
+class Profiler
+{
+
+
+public:
+	enum Phase
+	{
+		Step,			//whole simulation step
+		SetForces,		//decaying the forces and the fused prologue
+		Advection,		//semi-Lagrangian advection of the velocity
+		FFT,			//forward and inverse transforms of the velocity, and normalization
+		Projection,		//viscosity and projection in the frequency domain
+		Derivatives,	//spectral derivatives
+		DiffuseMatter,	//advection of the smoke density
+		Frame,			//whole display of a frame
+		SliceCapture,	//receiving frames and keeping slices
+		Smoke,			//drawing the smoke
+		Glyphs,			//drawing the glyphs
+		Streamlines,	//drawing the streamlines
+		Surfaces,		//drawing the stream surfaces
+		Legend,			//drawing the legend
+		InputLatency,	//from a mouse event to the end of the first frame that shows it
+		PhaseSize		//auto assigned (last in enum==size of enum)
+	};
+
+	//Timer: Add the time until the end of the scope to 'phase'
+	class Timer
+	{
+	public:
+		explicit Timer(Phase phase);
+		~Timer();
+		void next(Phase phase);
+		void stop();
+	private:
+		Phase phase;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	static void add(Phase phase, long nanoseconds);
+	static void sample(Phase phase, float milliseconds);
+	static void end_step();
+	static void end_frame();
+	static void summary(Phase phase, float *average, float *p99);
+	static bool open_csv(const char *path);
+	static void close_csv();
+
+	static const char *names[PhaseSize];
+	static const int WINDOW = 256;			//samples per phase in the rolling statistics
+
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef RING_HPP
+#define RING_HPP
+
+#include <algorithm>
+#include <vector>
+
+// Fixed ring of elements, oldest first. Turning the oldest element into the newest one with rotate() reuses its
+// memory, so a ring that keeps its size never allocates; only push_back and pop_front change the size.
+template<class T>
+class Ring
+{
+
+
+public:
+	Ring() : head(0) {}
+
+	T &operator[](size_t i) { return items[(head + i) % items.size()]; }
+	T const &operator[](size_t i) const { return items[(head + i) % items.size()]; }
+	size_t size() const { return items.size(); }
+	T &back() { return (*this)[items.size() - 1]; }
+
+	void clear() { items.clear(); head = 0; }
+	void reserve(size_t n) { items.reserve(n); }
+	void push_back(T &&item) { unwrap(); items.push_back(std::move(item)); }
+	void pop_front() { unwrap(); items.erase(items.begin()); }
+	void pop_back() { unwrap(); items.pop_back(); }
+	void swap(Ring &other) { items.swap(other.items); std::swap(head, other.head); }
+
+	//rotate: Make the oldest element the newest one and return it, to be overwritten in place
+	T &rotate() { head = (head + 1) % items.size(); return back(); }
+
+private:
+	//unwrap: Put the oldest element first again, so the ring can grow or shrink at the ends
+	void unwrap() { std::rotate(items.begin(), items.begin() + head, items.end()); head = 0; }
+
+	std::vector<T> items;
+	size_t head;				//index of the oldest element
+
+};
+
+#endif
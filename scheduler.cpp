@@ -0,0 +1,60 @@
+#include "scheduler.hpp"
+
+
+Scheduler::Scheduler()
+{
+	steps_per_second = 60;
+	max_steps = 4;
+	reset();
+}
+
+//reset: Forget the backlog, the next step is due right away
+void Scheduler::reset()
+{
+	next = first = now();
+}
+
+//steps_due: Number of steps that became due since the last call, at most max_steps.
+//           The k-th of these steps is scheduled for step_time(k).
+int Scheduler::steps_due()
+{
+	double t = now(), p = period();
+	int steps;
+
+	if (p == 0) { first = next = t; return 1; }
+	if (t < next) return 0;
+
+	steps = (int)((t - next) / p) + 1;
+	if (steps > max_steps)            //too far behind, drop the backlog
+	{
+		steps = max_steps;
+		next = t - (steps - 1) * p;
+	}
+	first = next;
+	next += steps * p;
+	return steps;
+}
+
+double Scheduler::step_time(int k)
+{
+	return first + k * period();
+}
+
+//period: Time between two simulation steps, in seconds
+double Scheduler::period()
+{
+	return steps_per_second > 0 ? 1.0 / steps_per_second : 0;
+}
+
+//wait: Time until the next step is due, in seconds
+double Scheduler::wait()
+{
+	double w = next - now();
+	return w > 0 ? w : 0;
+}
+
+//now: Wall-clock time in seconds, from a monotonic clock
+double Scheduler::now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
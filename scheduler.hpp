@@ -0,0 +1,31 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <chrono>
+
+// Fixed-timestep scheduler: decides how many simulation steps the wall clock requires, so the physical speed
+// of the fluid no longer depends on the display speed. Falling behind by more than max_steps drops the backlog
+// instead of trying to catch up.
+class Scheduler 
+{
+
+
+public:
+	Scheduler();
+	void reset();
+	int steps_due();
+	double step_time(int k);
+	double period();
+	double wait();
+	static double now();
+
+	float steps_per_second;		//simulation rate, 0 = one step per call
+	int max_steps;				//maximum number of steps returned by one call to steps_due
+
+private:
+	double next;				//time the next step is due
+	double first;				//time of the first step returned by the last call to steps_due
+
+};
+
+#endif
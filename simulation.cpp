@@ -1,78 +1,226 @@
+#include <cstring>
+#include <mutex>
+
+#include "fieldpublisher.hpp"
+#include "fieldrecorder.hpp"
+#include "inputlog.hpp"
+#include "scheduler.hpp"
 #include "simulation.hpp"
+#include "vtkexporter.hpp"
 
 
+int Simulation::DIM = 60;
 vector<Vector2> Simulation::seedpoints;
 
+const fftw_real FORCE_THRESHOLD = 1e-9;   //forces below this are retired from the active set
+const int FFT_THREADS = 1;                //the bundled FFTW is the single-threaded build
+static mutex planner;                     //FFTW's planner is not thread-safe; the solver and slice replicas both plan
+
 //------ SIMULATION CODE STARTS HERE -----------------------------------------------------------------
 Simulation::Simulation()
 {
+	plan_rc = plan_cr = NULL;
+	plan_n = 0;
+	last_input = 0;
+	display_only = false;
 	init_parameters();
 }
 
+//Simulation: A bare solver for an n*n grid, for rebuilding slices. It only steps 'fields'; it has no frames, slices
+//            or streams, and leaves the shared seed points alone.
+Simulation::Simulation(int n)
+{
+	plan_rc = plan_cr = NULL;
+	plan_n = 0;
+	last_input = 0;
+	display_only = false;
+	dt = 0.5;
+	visc = 0.001;
+	frozen = 0;
+	interpolation = 0;
+	brush_radius = 1;
+	publish_forces = false;
+	for (int i = 0; i < DerivativeSize; i++) derivatives[i] = 0;
+	number_of_slices = 0;
+	shown_slice = 0;
+	restartable_slices = 0;
+	keyframe_interval = 0;
+	step = 0;
+	blending = false;
+	parameters = shared = control_parameters();
+	fields.resize(n, true);
+	create_plans(n);
+	active_forces.reserve(n * n);
+	force_active.assign(n * n, 0);
+}
+
+Simulation::~Simulation()
+{
+	if (plan_rc) rfftwnd_destroy_plan(plan_rc);
+	if (plan_cr) rfftwnd_destroy_plan(plan_cr);
+}
+
 void Simulation::init_parameters()
 {
 	dt = 0.5;               //simulation time step
 	visc = 0.001;
 	frozen = 0;
+	interpolation = 1;
+	brush_radius = 1;
+	publish_forces = false;
+	shown_slice = 0;
+	restartable_slices = 0;
+	keyframe_interval = 0;
+	for (int i = 0; i < DerivativeSize; i++) derivatives[i] = 0;
+
+	SolverParameters stale;         //the solver is not running: hand the parameters over directly, dropping the
+	while (parameter_queue.pop(stale)) {}    //ones still queued
+	parameters = shared = control_parameters();
 	init_simulation();
 }
 
 //init_simulation: Initialize simulation data structures as a function of the grid size 'n'.
 //                 Although the simulation takes place on a 2D grid, we allocate all data structures as 1D arrays,
 //                 for compatibility with the FFTW numerical library.
+//                 With display_only set, only what the frames are drawn from is set up: no work arrays. The FFT
+//                 plans are made on the first step, so a simulation that never steps never measures them.
 void Simulation::init_simulation()
 {
 	int i, n = Simulation::DIM; 
-	size_t dim;
-
-	dim     = n * 2*(n/2+1)*sizeof(fftw_real);        //Allocate data structures
-	vx       = (fftw_real*) malloc(dim);
-	vy       = (fftw_real*) malloc(dim);
-	vx0      = (fftw_real*) malloc(dim);
-	vy0      = (fftw_real*) malloc(dim);
-	dim     = n * n * sizeof(fftw_real);
-	fx      = (fftw_real*) malloc(dim);
-	fy      = (fftw_real*) malloc(dim);
-	rho     = (fftw_real*) malloc(dim);
-	rho0    = (fftw_real*) malloc(dim);
-	plan_rc = rfftw2d_create_plan(n, n, FFTW_REAL_TO_COMPLEX, FFTW_IN_PLACE);
-	plan_cr = rfftw2d_create_plan(n, n, FFTW_COMPLEX_TO_REAL, FFTW_IN_PLACE);
-
-	for (i = 0; i < n * n; i++)                      //Initialize data structures to 0
-	{ vx[i] = vy[i] = vx0[i] = vy0[i] = fx[i] = fy[i] = rho[i] = rho0[i] = 0.0f; }
+
+	fields.resize(n, !display_only);                 //Allocate data structures, initialized to 0
+	active_forces.clear();
+	if (!display_only) active_forces.reserve(n * n);
+	force_active.assign(display_only ? 0 : n * n, 0);
+
+	step = 0;
+	for (i = 0; i < TripleBuffer<FieldSet>::SIZE; i++) frames.buffer(i).resize(n);
+	blended.resize(n);
+	blending = false;
 
 	seedpoints.clear(); //remove streamlines
+	seedpoints.reserve(SEEDPOINTS_AMOUNT);
 
 	number_of_slices = 20;
 	slices.clear(); //remove slices
+	spill.close();
+	history.clear();
+	slices.reserve(RESIDENT_SLICES); //most slices kept in memory
 	for (i = 0; i<number_of_slices; i++)
 	{
-		Grid* new_grid = new Grid(vx,vy, rho, fx, fy);
-		slices.push_back(*new_grid);
+		slices.push_back(FieldSet(n));
 	}
 	stream_surfaces.clear();
 
 }
 
 
+//wisdom_path: File that caches the FFTW wisdom for an n*n grid, in the cache directory.
+//             Wisdom depends on the grid size, the precision and the number of threads of the transforms.
+//             Returns an empty string if there is no place to keep it.
+static string wisdom_path(int n)
+{
+	string dir = cache_dir();
+	char name[64];
+
+	if (dir.empty()) return "";
+	snprintf(name, sizeof(name), "/fftw-wisdom-%dx%d-%s-%dt", n, n, sizeof(fftw_real) == sizeof(float) ? "float" : "double", FFT_THREADS);
+	return dir + name;
+}
+
+//create_plans: Create the FFT plans for an n*n grid. The plans are measured rather than estimated, which is
+//              slow the first time; the measurements are saved as FFTW wisdom, so later runs start instantly
+//              and still get the fastest plans.
+void Simulation::create_plans(int n)
+{
+	lock_guard<mutex> lock(planner);
+	string path = wisdom_path(n);
+	FILE *file;
+
+	if (plan_rc) rfftwnd_destroy_plan(plan_rc);
+	if (plan_cr) rfftwnd_destroy_plan(plan_cr);
+
+	if (!path.empty() && (file = fopen(path.c_str(), "r")))
+	{
+		fftw_import_wisdom_from_file(file);
+		fclose(file);
+	}
+	else
+		cout << "Measuring FFT plans for a " << n << "x" << n << " grid, this is only done once...\n" << flush;
+
+	plan_rc = rfftw2d_create_plan(n, n, FFTW_REAL_TO_COMPLEX, FFTW_IN_PLACE | FFTW_MEASURE | FFTW_USE_WISDOM);
+	plan_cr = rfftw2d_create_plan(n, n, FFTW_COMPLEX_TO_REAL, FFTW_IN_PLACE | FFTW_MEASURE | FFTW_USE_WISDOM);
+	plan_n = n;
+
+	if (!path.empty() && (file = fopen(path.c_str(), "w")))
+	{
+		fftw_export_wisdom_to_file(file);
+		fclose(file);
+	}
+}
+
+//ensure_plans: Create the FFT plans for the grid if they are not there yet. The first FFT does it; call it before
+//              timing the solver to keep the planning out. The plans are kept over a reset.
+void Simulation::ensure_plans()
+{
+	if (plan_n != fields.n) create_plans(fields.n);
+}
+
 //FFT: Execute the Fast Fourier Transform on the dataset 'vx'.
 //     'dirfection' indicates if we do the direct (1) or inverse (-1) Fourier Transform
 void Simulation::FFT(int direction,void* vx)
 {
+	ensure_plans();
 	if(direction==1) rfftwnd_one_real_to_complex(plan_rc,(fftw_real*)vx,(fftw_complex*)vx);
 	else             rfftwnd_one_complex_to_real(plan_cr,(fftw_complex*)vx,(fftw_real*)vx);
 }
 
 
 
-//solve: Solve (compute) one step of the fluid flow simulation
-void Simulation::solve(int n, fftw_real* vx, fftw_real* vy, fftw_real* vx0, fftw_real* vy0, fftw_real visc, fftw_real dt)
+//solve: Solve (compute) one step of the fluid flow simulation. On entry vx0 and vy0 must hold a copy of vx and vy,
+//       with the forces already integrated (set_forces does both); afterwards they are only work space.
+void Simulation::solve(int n, fftw_real* vx, fftw_real* vy, fftw_real* vx0, fftw_real* vy0, fftw_real visc, fftw_real dt,
+                       int derivatives)
 {
-	fftw_real x, y, x0, y0, f, r, U[2], V[2], s, t;
-	int i, j, i0, j0, i1, j1;
+	fftw_real f;
+	int i, j;
+	Profiler::Timer timer(Profiler::Advection);
+
+	advect(n, vx, vy, vx0, vy0, dt);
+
+	timer.next(Profiler::FFT);
+	FFT(1,vx0);
+	FFT(1,vy0);
 
-	for (i=0;i<n*n;i++)
-	{ vx[i] += dt*vx0[i]; vx0[i] = vx[i]; vy[i] += dt*vy0[i]; vy0[i] = vy[i]; }
+	timer.next(Profiler::Derivatives);
+	if (derivatives >> Divergence & 1) spectral_derivative(n, fields.divergence, vx0, vy0, 1, 1);
+
+	timer.next(Profiler::Projection);
+	project(n, vx0, vy0, visc, dt);
+
+	timer.next(Profiler::Derivatives);
+	if (derivatives >> Vorticity & 1) spectral_derivative(n, fields.vorticity, vy0, vx0, 1, -1);
+
+	timer.next(Profiler::FFT);
+	FFT(-1,vx0);
+	FFT(-1,vy0);
+	timer.next(Profiler::Derivatives);
+	if (derivatives >> Divergence & 1) spectral_inverse(n, fields.divergence);
+	if (derivatives >> Vorticity & 1) spectral_inverse(n, fields.vorticity);
+
+	timer.next(Profiler::FFT);
+	f = 1.0/(n*n);
+	for (i=0;i<n;i++)
+	   for (j=0;j<n;j++)
+	   { vx[i+n*j] = f*vx0[i+(n+2)*j]; vy[i+n*j] = f*vy0[i+(n+2)*j]; }
+}
+
+//advect: Trace the velocity field (vx0,vy0) back over dt into (vx,vy), then copy the result into vx0 and vy0 with
+//        the row padding the in-place FFT needs
+void Simulation::advect(int n, fftw_real* vx, fftw_real* vy, fftw_real* vx0, fftw_real* vy0, fftw_real dt)
+{
+	fftw_real x, y, x0, y0, s, t;
+	int i, j, i0, j0, i1, j1;
 
 	for ( x=0.5f/n,i=0 ; i<n ; i++,x+=1.0f/n )
 	   for ( y=0.5f/n,j=0 ; j<n ; j++,y+=1.0f/n )
@@ -92,9 +240,13 @@ void Simulation::solve(int n, fftw_real* vx, fftw_real* vy, fftw_real* vx0, fftw
 	for(i=0; i<n; i++)
 	  for(j=0; j<n; j++)
 	  {  vx0[i+(n+2)*j] = vx[i+n*j]; vy0[i+(n+2)*j] = vy[i+n*j]; }
+}
 
-	FFT(1,vx0);
-	FFT(1,vy0);
+//project: Apply viscosity and make the transformed velocity field (vx0,vy0) divergence free, in the frequency domain
+void Simulation::project(int n, fftw_real* vx0, fftw_real* vy0, fftw_real visc, fftw_real dt)
+{
+	fftw_real x, y, f, r, U[2], V[2];
+	int i, j;
 
 	for (i=0;i<=n;i+=2)
 	{
@@ -114,14 +266,6 @@ void Simulation::solve(int n, fftw_real* vx, fftw_real* vy, fftw_real* vx0, fftw
 		  vy0[i+1+(n+2)*j] = f*(  -y*x/r *U[1] + (1-y*y/r)*V[1]);
 	   }
 	}
-
-	FFT(-1,vx0);
-	FFT(-1,vy0);
-
-	f = 1.0/(n*n);
-	for (i=0;i<n;i++)
-	   for (j=0;j<n;j++)
-	   { vx[i+n*j] = f*vx0[i+(n+2)*j]; vy[i+n*j] = f*vy0[i+(n+2)*j]; }
 }
 
 
@@ -131,6 +275,7 @@ void Simulation::diffuse_matter(int n, fftw_real *vx, fftw_real *vy, fftw_real *
 {
 	fftw_real x, y, x0, y0, s, t;
 	int i, j, i0, j0, i1, j1;
+	Profiler::Timer timer(Profiler::DiffuseMatter);
 
 	for ( x=0.5f/n,i=0 ; i<n ; i++,x+=1.0f/n )
 		for ( y=0.5f/n,j=0 ; j<n ; j++,y+=1.0f/n )
@@ -149,68 +294,436 @@ void Simulation::diffuse_matter(int n, fftw_real *vx, fftw_real *vy, fftw_real *
 		}
 }
 
-//set_forces: copy user-controlled forces to the force vectors that are sent to the solver.
-//            Also dampen forces and matter density to get a stable simulation.
-void Simulation::set_forces(void)
+//spectral_derivative: Form the derivative field out = sx*df/dx + sy*dg/dy from the Fourier coefficients of 'f' and 'g'
+//                     by multiplying with i*k. The result is left in Fourier space in 'out'; use spectral_inverse()
+//                     to bring it back. Derivatives are expressed per grid cell, like the finite differences they replace.
+void Simulation::spectral_derivative(int n, fftw_real *out, fftw_real *f, fftw_real *g, fftw_real sx, fftw_real sy)
 {
+	fftw_real x, y, re, im, c = 2*M_PI/n;
+	int i, j, idx;
+
+	for (i=0;i<=n;i+=2)
+	{
+	   x = 0.5f*i;
+	   for (j=0;j<n;j++)
+	   {
+		  y = j<=n/2 ? (fftw_real)j : (fftw_real)j-n;
+		  idx = i+(n+2)*j;
+		  if (2*x==n || 2*j==n)                 //the Nyquist modes have no well-defined derivative
+		  { out[idx] = out[idx+1] = 0; continue; }
+		  re = -c*(sx*x*f[idx+1] + sy*y*g[idx+1]);  //out may alias f or g
+		  im =  c*(sx*x*f[idx]   + sy*y*g[idx]);
+		  out[idx] = re; out[idx+1] = im;
+	   }
+	}
+}
+
+//spectral_inverse: Transform a derivative field produced by spectral_derivative back to the grid, normalize it and
+//                  compact it from the padded FFTW layout to the n*n layout used by the other fields.
+void Simulation::spectral_inverse(int n, fftw_real *out)
+{
+	fftw_real f = 1.0/(n*n);
+	int i, j;
+
+	FFT(-1,out);
+	for (j=0;j<n;j++)
+	   for (i=0;i<n;i++)
+	   { out[i+n*j] = f*out[i+(n+2)*j]; }
+}
+
+//density_gradient: Compute the gradient of the smoke density in Fourier space. This costs one forward
+//                  and two inverse transforms, instead of a finite difference pass in the visualization.
+void Simulation::density_gradient(int n)
+{
+	int i, j;
+	Profiler::Timer timer(Profiler::Derivatives);
+
+	for (j=0;j<n;j++)
+	   for (i=0;i<n;i++)
+	   { fields.grad_y[i+(n+2)*j] = fields.rho[i+n*j]; }
+
+	FFT(1,fields.grad_y);
+	spectral_derivative(n, fields.grad_x, fields.grad_y, fields.grad_y, 1, 0);
+	spectral_derivative(n, fields.grad_y, fields.grad_y, fields.grad_y, 0, 1);
+	spectral_inverse(n, fields.grad_x);
+	spectral_inverse(n, fields.grad_y);
+}
+
+//clear_derivatives: Zero the derivative fields, so a derivative that is switched off does not leave a stale field behind
+void Simulation::clear_derivatives()
+{
+	int n = fields.n;
+	size_t dim = n * 2*(n/2+1) * sizeof(fftw_real);
+	memset(fields.vorticity, 0, dim);
+	memset(fields.divergence, 0, dim);
+	memset(fields.grad_x, 0, dim);
+	memset(fields.grad_y, 0, dim);
+}
+
+//prologue: The dense part of set_forces, fused into one sweep over memory: dampen the matter density into rho0 and
+//          copy the velocity into the solver's work arrays. The restrict qualifiers let the compiler vectorize it.
+static void prologue(int count, fftw_real * __restrict__ rho0, const fftw_real * __restrict__ rho,
+                     fftw_real * __restrict__ vx0, const fftw_real * __restrict__ vx,
+                     fftw_real * __restrict__ vy0, const fftw_real * __restrict__ vy)
+{
+	for (int i = 0; i < count; i++)
+	{
+		rho0[i] = 0.995 * rho[i];
+		vx0[i]  = vx[i];
+		vy0[i]  = vy[i];
+	}
+}
+
+//set_forces: Prologue of a simulation step. Dampen the user-controlled forces and integrate them into the velocity
+//            field. Only the cells in the active set carry a force, so this part scales with the interaction rather
+//            than with the grid size. Forces that have decayed below FORCE_THRESHOLD are zeroed and retired from
+//            the active set. Then dampen matter density to get a stable simulation and set up vx0/vy0 for solve(),
+//            in a single pass over the grid.
+void Simulation::set_forces(fftw_real dt)
+{
+	size_t a, k = 0;
 	int i;
-	for (i = 0; i < DIM * DIM; i++)
+	Profiler::Timer timer(Profiler::SetForces);
+	for (a = 0; a < active_forces.size(); a++)
 	{
-		rho0[i]  = 0.995 * rho[i];
-		fx[i] *= 0.85;
-		fy[i] *= 0.85;
-		vx0[i]    = fx[i];
-		vy0[i]    = fy[i];
+		i = active_forces[a];
+		fields.fx[i] *= 0.85;
+		fields.fy[i] *= 0.85;
+		fields.vx[i] += dt*fields.fx[i];
+		fields.vy[i] += dt*fields.fy[i];
+		if (fabs(fields.fx[i]) < FORCE_THRESHOLD && fabs(fields.fy[i]) < FORCE_THRESHOLD)
+		{ fields.fx[i] = fields.fy[i] = 0; force_active[i] = 0; }
+		else
+			active_forces[k++] = i;
+	}
+	active_forces.resize(k);
+
+	prologue(DIM * DIM, fields.rho0, fields.rho, fields.vx0, fields.vx, fields.vy0, fields.vy);
+}
+
+//activate_force: Add a cell to the active set, when it starts carrying a force
+void Simulation::activate_force(int idx)
+{
+	if (force_active[idx]) return;
+	force_active[idx] = 1;
+	active_forces.push_back(idx);
+}
+
+//insert_forces: Queue a force (dx,dy) along the mouse path from (x0,y0) to (x1,y1), in grid coordinates.
+//               The force is applied at the start of the next step, so the caller never touches the solver arrays.
+void Simulation::insert_forces(float x0, float y0, float x1, float y1, double dx, double dy)
+{
+	InputEvent event = {++last_input, Scheduler::now(), x0, y0, x1, y1, dx, dy};
+	input.push(event);          //a full queue drops the event, the solver is not keeping up anyway
+	if (Tracer::recording())
+	{
+		Tracer::span("insert_forces", event.time, Scheduler::now());
+		Tracer::flow('s', "input", event.id, event.time);
 	}
 }
 
 void Simulation::insert_forces(int X, int Y, double dx, double dy)
 {
-	fx[Y * DIM + X] += dx;
-	fy[Y * DIM + X] += dy;
-	rho[Y * DIM + X] = 10.0f;
+	insert_forces(X, Y, X, Y, dx, dy);
+}
+
+//apply_input: Splat all queued mouse events into the force and density fields
+void Simulation::apply_input()
+{
+	AllocStats::Scope scope(AllocStats::Input);
+	InputEvent event;
+	while (input.pop(event))
+	{
+		splat(event, parameters.brush_radius);
+		fields.input = event.id;
+		fields.input_time = event.time;
+		if (InputLog::recording()) InputLog::force(step, event);
+		if (history.active()) history.input(step + 1, event, parameters.brush_radius);
+		if (Tracer::recording()) Tracer::flow('t', "input", event.id, Scheduler::now());
+	}
+}
+
+//splat: Rasterize one mouse event with a radial brush. Every cell within brush_radius of the mouse path gets
+//       the force, weighted by its distance to the path, so fast mouse motion no longer skips cells.
+//       A brush radius of half a cell or less reduces to the single cell under the cursor.
+void Simulation::splat(InputEvent const &event, float brush_radius)
+{
+	int i, j, n = DIM;
+	float r = std::max(brush_radius, 0.5f);
+	float sx = event.x1 - event.x0, sy = event.y1 - event.y0, len2 = sx*sx + sy*sy;
+	int i0 = (int)clamp(floor(std::min(event.x0, event.x1) - r), 0, n-1);
+	int i1 = (int)clamp(ceil(std::max(event.x0, event.x1) + r), 0, n-1);
+	int j0 = (int)clamp(floor(std::min(event.y0, event.y1) - r), 0, n-1);
+	int j1 = (int)clamp(ceil(std::max(event.y0, event.y1) + r), 0, n-1);
+
+	for (j = j0; j <= j1; j++)
+		for (i = i0; i <= i1; i++)
+		{
+			float t = len2 > 0 ? clamp(((i - event.x0)*sx + (j - event.y0)*sy) / len2, 0, 1) : 0;
+			float px = event.x0 + t*sx - i, py = event.y0 + t*sy - j;    //offset to the nearest point on the path
+			float d2 = px*px + py*py;
+			if (d2 > r*r) continue;
+
+			float w = 1 - d2/(r*r);
+			activate_force(j * n + i);
+			fields.fx[j * n + i] += w * event.dx;
+			fields.fy[j * n + i] += w * event.dy;
+			fields.rho[j * n + i] = std::max(fields.rho[j * n + i], (fftw_real)(10.0f * w));
+		}
 }
 
 void Simulation::change_number_of_slices() 
 {
-	int difference = Simulation::number_of_slices-slices.size();
+	if (number_of_slices > MAX_SLICES) number_of_slices = MAX_SLICES;
+	if ((number_of_slices > RESIDENT_SLICES) != spill.is_open()) spill_slices(number_of_slices > RESIDENT_SLICES);
 
-	for(int i=0; i<abs(difference);i++)
+	while ((int)slices.size() > number_of_slices)   //add_slice grows the ring again, one slice per frame
 	{
-		if(difference<0) slices.pop_front();
-		if(difference>0) {
-			Grid *new_grid = new Grid(vx,vy,rho,fx,fy);
-			slices.push_back(*new_grid);
+		if (spill.is_open()) spill.give(slices[0]);
+		slices.pop_front();
+	}
+}
+
+//spill_slices: Move the slices into a scratch file, or back into memory. Falls back to RESIDENT_SLICES slices in
+//              memory if the file cannot be created.
+void Simulation::spill_slices(bool spilled)
+{
+	{
+		Ring<FieldSet> old;
+		old.swap(slices);
+		if (spilled && !spill.open(DIM, MAX_SLICES)) number_of_slices = RESIDENT_SLICES;
+		slices.reserve(spill.is_open() ? MAX_SLICES : RESIDENT_SLICES);
+		for (size_t i = 0; i < old.size() && (int)i < number_of_slices; i++)
+		{
+			slices.push_back(spilled ? new_slice() : FieldSet(DIM));
+			slices.back().copy_from(old[old.size() - std::min<size_t>(old.size(), number_of_slices) + i]);
 		}
 	}
+	if (!spilled) spill.close();        //after the slices attached to it are gone
 }
 
+//new_slice: A slice in memory, or attached to a slot of the scratch file while the slices are spilled
+FieldSet Simulation::new_slice()
+{
+	FieldSet slice;
+	if (spill.is_open()) slice.attach(DIM, spill.take());
+	else slice.resize(DIM);
+	return slice;
+}
 
 void Simulation::add_slice()
 {
+	if ((int)slices.size() < number_of_slices) slices.push_back(new_slice());
+	else slices.rotate();                                //overwrite the oldest slice
+	slices.back().copy_from(frames.front_buffer());
+	if (spill.is_open() && slices.size() > RESIDENT_SLICES)     //it pushed one out of the resident window
+		spill.evict(slices[slices.size() - 1 - RESIDENT_SLICES]);
+}
 
-	Grid *new_grid = new Grid(vx, vy, rho, fx, fy);
-	slices.pop_front();
-	slices.push_back(*new_grid);
+//prefetch_slice: Start reading slice i in, ahead of drawing it, when the slices are spilled
+void Simulation::prefetch_slice(int i) const
+{
+	if (spill.is_open() && i >= 0 && i < (int)slices.size()) spill.prefetch(slices[i]);
+}
 
+//release_slice: Let slice i go from memory after drawing it, unless it is one of the newest RESIDENT_SLICES
+void Simulation::release_slice(int i) const
+{
+	if (spill.is_open() && i >= 0 && i < (int)slices.size() - RESIDENT_SLICES) spill.evict(slices[i]);
 }
 
-//do_one_simulation_step: Do one complete cycle of the simulation:
-//      - set_forces:
-//      - solve:            read forces from the user
-//      - diffuse_matter:   compute a new set of velocities
-//      - gluPostRedisplay: draw a new visualization frame
-void Simulation::do_one_simulation_step(void)
+//publish_frame: Copy the fields of the step that just completed into the back buffer of the frame buffer and
+//               hand it to the visualization. Runs on whichever thread runs the solver.
+void Simulation::publish_frame(double time, bool keyframe)
+{
+	FieldSet &f = frames.back_buffer();
+
+	fields.forces = true;
+	f.copy_from(fields, publish_forces || keyframe || parameters.restartable_slices);  //the force field is only
+	                                                  //copied for the views that draw it, keyframes and restartable
+	                                                  //slices
+	f.step = ++step;
+	f.time = time;
+	if (FieldRecorder::recording()) FieldRecorder::record(f);
+	if (VtkExporter::exporting()) VtkExporter::record(f, parameters.derivatives);
+	if (FieldPublisher::publishing()) FieldPublisher::publish(f, parameters.derivatives);
+	frames.publish();
+}
+
+//receive_frame: Pick up the latest published frame, if any, and record it in the slices.
+//               Runs on the GLUT thread, which is the only one touching the slices.
+bool Simulation::receive_frame()
 {
-	if (!frozen)
+	AllocStats::Scope scope(AllocStats::Slices);
+	Profiler::Timer timer(Profiler::SliceCapture);
+	if (!frames.update()) return false;
+	change_keyframe_interval();
+	if (history.active()) history.receive(frames.front_buffer(), number_of_slices);
+	else
 	{
-		set_forces();
-		solve(DIM, vx, vy, vx0, vy0, visc, dt);
-		diffuse_matter(DIM, vx, vy, rho, rho0, dt);
 		change_number_of_slices();
 		add_slice();
-		glutPostRedisplay();
 	}
+	return true;
+}
+
+//change_keyframe_interval: Switch between keeping every slice and rebuilding them from keyframes. A display only
+//                          simulation always keeps every slice, it has no solver to rebuild them with.
+void Simulation::change_keyframe_interval()
+{
+	if (display_only) keyframe_interval = 0;
+	if (keyframe_interval > 0) history.start(keyframe_interval);    //changes the interval if already started
+	else if (history.active()) history.stop();
+	if (history.active() && slices.size())
+	{
+		slices.clear();
+		spill.close();
+	}
+}
+
+//slice: Slice i of the history, oldest first
+FieldSet const &Simulation::slice(int i) const
+{
+	return history.active() ? history.slice(i) : slices[i];
+}
+
+int Simulation::slice_count() const
+{
+	return history.active() ? history.size() : slices.size();
+}
+
+//slice_step: Step of slice i, without reading or rebuilding the slice
+long Simulation::slice_step(int i) const
+{
+	return history.active() ? history.step(i) : slices[i].step;
+}
+
+//interpolate: Blend the last two frames received at wall-clock 'time'. Drawing slightly in the past, one step
+//             period behind, gives smooth motion when the solver runs at a lower rate than the display.
+void Simulation::interpolate(double time)
+{
+	FieldSet const &a = frames.previous_buffer();
+	FieldSet const &b = frames.front_buffer();
+	fftw_real alpha = 1;
+
+	if (b.time > a.time) alpha = clamp((time - a.time) / (b.time - a.time), 0, 1);
+	blending = interpolation && alpha < 1;
+	if (blending) blended.blend(a, b, alpha);
+}
+
+//frame: The frame to draw: the slice picked by shown_slice, the latest frame received, or the blend computed by
+//       interpolate()
+FieldSet const &Simulation::frame() const
+{
+	if (shown_slice > 0 && shown_slice < slice_count()) return slice(slice_count() - 1 - shown_slice);
+	return blending ? blended : frames.front_buffer();
+}
+
+//rewind: Continue the simulation from slice i, oldest first, to explore a different future. The solver takes over
+//        the fields and forces of the slice; its work arrays need no restoring, set_forces rewrites them before
+//        they are read. The slices after slice i are dropped. The solver must not be running.
+//        Returns false if the slice does not carry its forces.
+bool Simulation::rewind(int i)
+{
+	if (i < 0 || i >= slice_count() || !slice(i).forces) return false;
+	load_state(slice(i));
+	for (int b = 0; b < TripleBuffer<FieldSet>::SIZE; b++) frames.buffer(b).copy_from(fields);
+	blending = false;
+
+	if (history.active()) history.truncate(i);
+	while ((int)slices.size() > i + 1)
+	{
+		if (spill.is_open()) spill.give(slices.back());
+		slices.pop_back();
+	}
+	return true;
+}
+
+//do_one_simulation_step: Do one complete cycle of the simulation:
+//      - apply_input:      splat the queued mouse events
+//      - advance:          compute the new fields
+//      - publish_frame:    hand the new fields to the visualization, stamped with the step's scheduled 'time'
+//      The whole step is computed with the parameters taken at its start.
+void Simulation::do_one_simulation_step(double time)
+{
+	AllocStats::Scope scope(AllocStats::Solver);
+	if (!take_parameters().frozen)
+	{
+		Profiler::Timer timer(Profiler::Step);
+		apply_input();
+		bool keyframe = history.begin_step(step + 1, parameters);
+		advance(parameters);
+		publish_frame(time, keyframe);
+		timer.stop();
+		Profiler::end_step();
+	}
+}
+
+//advance: The deterministic part of a step, from the fields and forces after the input to the next fields:
+//      - set_forces:
+//      - solve:            read forces from the user
+//      - diffuse_matter:   compute a new set of velocities
+//      - density_gradient: emit the spectral density gradient, when requested
+//      All with 'parameters', never with the members the control side edits.
+void Simulation::advance(SolverParameters const &parameters)
+{
+	set_forces(parameters.dt);
+	solve(DIM, fields.vx, fields.vy, fields.vx0, fields.vy0, parameters.visc, parameters.dt, parameters.derivatives);
+	diffuse_matter(DIM, fields.vx, fields.vy, fields.rho, fields.rho0, parameters.dt);
+	if (parameters.derivatives >> DensityGradient & 1) density_gradient(DIM);
+}
+
+//load_state: Continue from 'state', a frame that carries its forces: take over its fields and rebuild the active
+//            set from the forces
+void Simulation::load_state(FieldSet const &state)
+{
+	fields.copy_from(state);
+	for (size_t a = 0; a < active_forces.size(); a++) force_active[active_forces[a]] = 0;
+	active_forces.clear();
+	for (int idx = 0; idx < state.n * state.n; idx++)
+		if (fields.fx[idx] != 0 || fields.fy[idx] != 0) activate_force(idx);
+	step = state.step;
+}
+
+//share_parameters: Hand the parameters edited on the control side to the solver, which takes them on at the start
+//                  of its next step. Control side only. Does nothing if they did not change; when the queue is full
+//                  the next call tries again.
+void Simulation::share_parameters()
+{
+	SolverParameters edited = control_parameters();
+	if (!memcmp(&edited, &shared, sizeof(edited))) return;
+	if (parameter_queue.push(edited)) shared = edited;
+}
+
+//take_parameters: Take on the parameters handed over last, solver side
+SolverParameters const &Simulation::take_parameters()
+{
+	SolverParameters latest;
+	while (parameter_queue.pop(latest)) use_parameters(latest);
+	return parameters;
+}
+
+//use_parameters: Compute the next steps with 'p'. A derivative switched off has its field zeroed, so it does not
+//                leave a stale field behind.
+void Simulation::use_parameters(SolverParameters const &p)
+{
+	if (parameters.derivatives & ~p.derivatives) clear_derivatives();
+	parameters = p;
+}
+
+//control_parameters: The parameters as the control side has them
+SolverParameters Simulation::control_parameters() const
+{
+	SolverParameters p;
+	memset(&p, 0, sizeof(p));
+	p.dt = dt;
+	p.visc = visc;
+	p.brush_radius = brush_radius;
+	p.frozen = frozen;
+	p.restartable_slices = restartable_slices;
+	for (int i = 0; i < DerivativeSize; i++)
+		if (derivatives[i]) p.derivatives |= 1 << i;
+	return p;
 }
 
 void Simulation::change_timestep(float step)
@@ -230,22 +743,25 @@ void Simulation::toggle_frozen()
 
 void Simulation::add_seedpoint(Vector2 point)
 {
+	AllocStats::Scope scope(AllocStats::Streams);
+	if (InputLog::recording()) InputLog::seedpoint(step, point);
 	if(seedpoints.size()<SEEDPOINTS_AMOUNT) seedpoints.push_back(point);
 }
 
 void Simulation::add_streamsurface(Vector2 p1, Vector2 p2)
 {
+	AllocStats::Scope scope(AllocStats::Streams);
+	if (InputLog::recording()) InputLog::streamsurface(step, p1, p2);
 	Vector2 diff = p1-p2;
-	Vector2 *seed_points = (Vector2*) malloc(8);
-	for(int i=0; i<8;i++)
+	Vector2 seed_points[Stream_Surface::SEED_POINTS];
+	for(int i=0; i<Stream_Surface::SEED_POINTS;i++)
 	{
-		seed_points[i]=p1+(diff*(float)i)/7.0;
+		seed_points[i]=p1+(diff*(float)i)/(Stream_Surface::SEED_POINTS-1);
 		// cout << seed_points[i].x << " , y: " << seed_points[i].y << "\n";
 	}
 
-	Stream_Surface* stream_surface = new Stream_Surface(seed_points);
 	// cout << stream_surfaces.size() << "\n";
-	if(stream_surfaces.size()<STREAMSURFACE_SIZE) 	stream_surfaces.push_front(*stream_surface);
+	if(stream_surfaces.size()<STREAMSURFACE_SIZE) 	stream_surfaces.push_front(Stream_Surface(seed_points));
 
 
 }
@@ -1,7 +1,8 @@
 #ifndef SIMULATION_HPP
 #define SIMULATION_HPP
 
-#include <GL/glut.h>
+#include <algorithm>
+#include <atomic>
 #include <math.h>               //for various math functions
 #include <rfftw.h>              //the numerical simulation FFTW library
 #include <string>
@@ -10,57 +11,162 @@
 
 #include <iostream>
 
-#include "grid.hpp"
+#include "allocstats.hpp"
+#include "fieldset.hpp"
+#include "profiler.hpp"
+#include "ring.hpp"
+#include "slicehistory.hpp"
+#include "slicespill.hpp"
+#include "spscqueue.hpp"
+#include "tracer.hpp"
 #include "streamsurface.hpp"
+#include "triplebuffer.hpp"
 #include "util.hpp"
 #include "vector2.hpp"
 
 using namespace std;
 
+// A mouse drag from (x0,y0) to (x1,y1), in grid coordinates, that pushes the fluid with force (dx,dy)
+struct InputEvent
+{
+	long id;				//tag that follows the event to the frame that first shows it
+	double time;			//wall-clock time the event was generated
+	float x0, y0, x1, y1;
+	fftw_real dx, dy;
+};
+
+// The parameters a step is computed with. The control side (GLUT thread, or the server's main thread) edits the
+// public members of Simulation and hands a copy to the solver with share_parameters(); the solver takes the latest
+// copy once, at the start of a step, so a step never sees a parameter change half way.
+struct SolverParameters
+{
+	float dt;				//simulation time step
+	float visc;				//fluid viscosity
+	float brush_radius;		//radius of the brush the step's mouse events are splatted with
+	int frozen;				//no steps are done
+	int restartable_slices;	//copy the forces into every frame
+	int derivatives;		//bit mask of the Simulation::Derivative fields computed
+};
+
 class Simulation {
 
 friend class Visualization;		
+friend class Bench;
+friend class Conformance;
+friend class Checkpoint;
+friend class FieldPlayer;
+friend class FieldSubscriber;
+friend class SliceHistory;
 
 public:
 	Simulation();
+	~Simulation();
 	void init_parameters();
 	void init_simulation();
+	void ensure_plans();
 
-	void do_one_simulation_step(void);
+	void do_one_simulation_step(double time = 0);
+	void share_parameters();
+	SolverParameters const &take_parameters();
 	void change_timestep(float step);
 	void change_viscosity(double viscosity);
 	void toggle_frozen();
 	void insert_forces(int X, int Y, double dx, double dy);
+	void insert_forces(float x0, float y0, float x1, float y1, double dx, double dy);
 	void add_seedpoint(Vector2 point);
 	void add_streamsurface(Vector2 p1, Vector2 p2);
+	bool rewind(int i);
+	bool receive_frame();
+	void interpolate(double time);
+	FieldSet const &frame() const;
+	FieldSet const &slice(int i) const;
+	int slice_count() const;
+	long slice_step(int i) const;
+	void prefetch_slice(int i) const;
+	void release_slice(int i) const;
 
-    static const int DIM = 60;				//size of simulation grid
+	enum Derivative // Derivative fields the solver can emit from its Fourier-space velocity
+	{
+		Vorticity,			//curl of the projected velocity field
+		Divergence,			//divergence of the advected velocity, before projection
+		DensityGradient,	//gradient of the smoke density (grad_x, grad_y)
+		DerivativeSize		//auto assigned (last in enum==size of enum)
+	};
+
+    static int DIM;				//size of simulation grid, takes effect on the next reset
     static const int STREAMLINE_LENGTH = 60; // length of a streamline
     static const int SEEDPOINTS_AMOUNT = 100; // amount of seedpoints
     static const int STREAMSURFACE_SIZE = 30; // max amount of streamsurfaces
-	float dt;				//simulation time step
+    static const int RESIDENT_SLICES = 50;	//slices kept in memory; a longer history is spilled to a scratch file
+    static const int MAX_SLICES = 5000;	//longest slice history
+    static const int PREFETCH_SLICES = 4;	//slices read ahead while drawing a spilled history
+    static const int MAX_KEYFRAME_INTERVAL = 100;	//most steps between two keyframes of the slice history
+	float dt;				//simulation time step, control side like the other SolverParameters members
 	float visc;				//fluid viscosity
 	int   frozen ;               //toggles on/off the animation
 	// static Vector2 seedpoints[SEEDPOINTS_AMOUNT][STREAMLINE_LENGTH];
 	static vector<Vector2> seedpoints;
 	deque<Stream_Surface> stream_surfaces;
-	deque<Grid> slices;
+	Ring<FieldSet> slices;
 	int number_of_slices;
+	int shown_slice;		//slices back from the newest to show instead of the latest frame, 0 shows the latest frame
+	int restartable_slices;	//copy the forces into every frame, so the solver can resume from any slice
+	int keyframe_interval;	//keep a keyframe every this many steps and rebuild the slices in between, 0 keeps every slice
+	int derivatives[DerivativeSize];	//toggles on/off the spectral derivative fields
+	atomic<long> step;		//number of simulation steps done since the last reset, also stamps the GLUT thread's input log records
+	int interpolation;		//toggles on/off drawing frames interpolated between the last two steps
+	float brush_radius;		//radius, in grid cells, of the brush that splats mouse forces into the grid
+	atomic<bool> publish_forces;	//copy the force field into the frames, only needed when it is drawn
+	long last_input;		//id of the last mouse event queued, GLUT thread only
+	bool display_only;		//only show frames made elsewhere (played back, or served); the solver is never set up
 private:
+	explicit Simulation(int n);
 	void FFT(int direction,void* vx);
+	void create_plans(int n);
 	float max(float x, float y);
-	void solve(int n, fftw_real* vx, fftw_real* vy, fftw_real* vx0, fftw_real* vy0, fftw_real visc, fftw_real dt);
+	void solve(int n, fftw_real* vx, fftw_real* vy, fftw_real* vx0, fftw_real* vy0, fftw_real visc, fftw_real dt,
+	           int derivatives = 0);
+	void advect(int n, fftw_real* vx, fftw_real* vy, fftw_real* vx0, fftw_real* vy0, fftw_real dt);
+	void project(int n, fftw_real* vx0, fftw_real* vy0, fftw_real visc, fftw_real dt);
 	void diffuse_matter(int n, fftw_real *vx, fftw_real *vy, fftw_real *rho, fftw_real *rho0, fftw_real dt);
-	void set_forces(void);
+	void set_forces(fftw_real dt);
+	void advance(SolverParameters const &parameters);
+	void load_state(FieldSet const &state);
+	void apply_input();
+	void splat(InputEvent const &event, float brush_radius);
+	SolverParameters control_parameters() const;
+	void use_parameters(SolverParameters const &p);
+	void clear_derivatives();
+	void activate_force(int idx);
+	void spectral_derivative(int n, fftw_real *out, fftw_real *f, fftw_real *g, fftw_real sx, fftw_real sy);
+	void spectral_inverse(int n, fftw_real *out);
+	void density_gradient(int n);
 	void change_number_of_slices();
+	void change_keyframe_interval();
+	void spill_slices(bool spilled);
+	FieldSet new_slice();
 	void add_slice();
+	void publish_frame(double time, bool keyframe = false);
 	
 	//--- SIMULATION PARAMETERS ------------------------------------------------------------------------
-	fftw_real *vx, *vy;             //(vx,vy)   = velocity field at the current moment
-	fftw_real *vx0, *vy0;           //(vx0,vy0) = velocity field at the previous moment
-	fftw_real *fx, *fy;	            //(fx,fy)   = user-controlled simulation forces, steered with the mouse
-	fftw_real *rho, *rho0;			//smoke density at the current (rho) and previous (rho0) moment
+	FieldSet fields;                //(vx,vy)   = velocity field at the current moment
+	                                //(vx0,vy0) = velocity field at the previous moment
+	                                //(fx,fy)   = user-controlled simulation forces, steered with the mouse
+	                                //rho, rho0 = smoke density at the current (rho) and previous (rho0) moment
+	                                //and the spectral derivatives: vorticity, divergence, grad_x, grad_y
+	vector<int> active_forces;      //indices of the cells with a nonzero force, the only ones set_forces visits
+	vector<char> force_active;      //per cell: is it in active_forces
 	rfftwnd_plan plan_rc, plan_cr;  //simulation domain discretization
+	int plan_n;                     //grid size the plans were created for
+	TripleBuffer<FieldSet> frames;     //completed steps, handed from the solver to the visualization
+	SpscQueue<InputEvent, 1024> input;  //mouse events, handed from the GLUT thread to the solver
+	SpscQueue<SolverParameters, 16> parameter_queue;  //parameter changes, handed from the control side to the solver
+	SolverParameters shared;        //parameters handed to the solver last, control side only
+	SolverParameters parameters;    //parameters the current step is computed with, solver side only
+	FieldSet blended;               //interpolated frame drawn between steps
+	bool blending;                  //frame() returns the blended frame
+	SliceSpill spill;               //backing file of the slices, open while there are more than RESIDENT_SLICES
+	mutable SliceHistory history;   //keyframes the slices are rebuilt from, used instead of 'slices' when started
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "simulationserver.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+#include <thread>
+
+#include "fieldpublisher.hpp"
+#include "scheduler.hpp"
+#include "simulation.hpp"
+#include "simulationthread.hpp"
+#include "visualization.hpp"
+
+using namespace std;
+
+static atomic<bool> interrupted(false);
+
+static void interrupt(int)
+{
+      interrupted.store(true);
+}
+
+//wanted: Whether the command line asks for a server rather than the interactive program
+bool SimulationServer::wanted(int argc, char **argv)
+{
+      for (int i = 1; i + 1 < argc; i++)
+            if (!strcmp(argv[i], "--serve")) return true;
+      return false;
+}
+
+//SimulationServer: Take the options of a server from the command line:
+//                  --serve NAME  --grid 60  --rate 60  --cpus 2,3
+SimulationServer::SimulationServer(int argc, char **argv) : steps_per_second(Scheduler().steps_per_second)
+{
+      for (int i = 1; i + 1 < argc; i += 2)
+      {
+            if (!strcmp(argv[i], "--serve")) name = argv[i + 1];
+            else if (!strcmp(argv[i], "--grid")) Simulation::DIM = atoi(argv[i + 1]);
+            else if (!strcmp(argv[i], "--rate")) steps_per_second = atof(argv[i + 1]);
+            else if (!strcmp(argv[i], "--cpus"))
+                  for (char *cpu = strtok(argv[i + 1], ","); cpu; cpu = strtok(NULL, ",")) cpus.push_back(atoi(cpu));
+            else fprintf(stderr, "Ignoring unknown option %s\n", argv[i]);
+      }
+      if (name.empty() || name[0] != '/') name = "/" + name;      //shm_open names start with a slash
+}
+
+//pin: Keep this process, and the threads it starts from now on, on the cores asked for
+bool SimulationServer::pin()
+{
+      cpu_set_t set;
+      if (cpus.empty()) return true;
+      CPU_ZERO(&set);
+      for (size_t i = 0; i < cpus.size(); i++)
+            if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE) CPU_SET(cpus[i], &set);
+      return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+//apply: Apply a record a viewer sent. The viewers draw for themselves, so only what steers the solver is taken:
+//       the mouse forces, the solver's parameters and resets. The parameters are only edited here; run() hands
+//       them to the solver, which takes them on at its next step. The viewers keep their own slices.
+void SimulationServer::apply(InputLog::Record const &record, Simulation &simulation, SimulationThread &thread,
+                             Visualization &visualization)
+{
+      switch (record.type)
+      {
+            case InputLog::Force:
+                  simulation.insert_forces(record.force.x0, record.force.y0, record.force.x1, record.force.y1,
+                                           record.force.dx, record.force.dy);
+                  break;
+            case InputLog::Change:
+                  if (record.parameter <= InputLog::BrushRadius ||
+                      (record.parameter >= InputLog::VorticityDerivative && record.parameter <= InputLog::GradientDerivative))
+                        InputLog::set(simulation, visualization, record.parameter, record.value);
+                  simulation.publish_forces = true;     //whether a viewer draws them is up to the viewer
+                  break;
+            case InputLog::Reset:
+                  thread.stop();        //the solver arrays are reallocated
+                  simulation.init_parameters();
+                  simulation.publish_forces = true;
+                  thread.start();
+                  break;
+      }
+}
+
+//run: Serve until interrupted. Returns the exit status of the process.
+int SimulationServer::run()
+{
+      Simulation simulation;
+      Scheduler scheduler;
+      SimulationThread thread(simulation, scheduler);
+      Visualization visualization;      //takes the viewers' drawing parameters, never draws
+      string input = name + "-input";
+      int viewers = 0;
+
+      if (!pin()) perror("Cannot pin the server to the cores asked for");
+      visualization.glut = false;
+      scheduler.steps_per_second = steps_per_second;
+      simulation.publish_forces = true;
+      if (!FieldPublisher::start(name.c_str(), Simulation::DIM) || !commands.create(input.c_str()))
+      {
+            fprintf(stderr, "Cannot create the shared memory objects %s and %s\n", name.c_str(), input.c_str());
+            FieldPublisher::stop();
+            return 1;
+      }
+      signal(SIGINT, interrupt);
+      signal(SIGTERM, interrupt);
+      printf("Serving a %dx%d grid at %.0f steps per second as %s, run smoke --view %s to attach\n",
+             Simulation::DIM, Simulation::DIM, steps_per_second, name.c_str(), name.c_str());
+      fflush(stdout);
+
+      thread.start();
+      double checked = Scheduler::now();
+      while (!interrupted.load())
+      {
+            InputLog::Record record;
+            while (commands.receive(record)) apply(record, simulation, thread, visualization);
+            simulation.share_parameters();      //the changes of all the records received, in one hand-over
+            if (Scheduler::now() - checked > 0.5)      //free the lanes of viewers that died
+            {
+                  int attached = commands.reclaim();
+                  if (attached != viewers) printf("%d viewer%s attached\n", attached, attached == 1 ? "" : "s");
+                  fflush(stdout);
+                  viewers = attached;
+                  checked = Scheduler::now();
+            }
+            this_thread::sleep_for(chrono::milliseconds(1));
+      }
+
+      thread.stop();
+      printf("Stopped after %ld steps\n", simulation.step.load());
+      FieldPublisher::stop();
+      commands.close();
+      return 0;
+}
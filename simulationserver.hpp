@@ -0,0 +1,39 @@
+#ifndef SIMULATIONSERVER_HPP
+#define SIMULATIONSERVER_HPP
+
+#include <string>
+#include <vector>
+
+#include "commandqueue.hpp"
+
+class Simulation;
+class SimulationThread;
+class Visualization;
+
+// Headless simulation process for viewers in other processes (smoke --view). The solver runs on its own thread at
+// the scheduler's rate, optionally pinned to a set of cores, and publishes every step to the shared memory object
+// NAME through FieldPublisher; viewers send their input back through the CommandQueue NAME-input. Viewers come
+// and go, crash or stall without the solver noticing: it never waits for them, and their lanes are freed when
+// they are gone. Runs until interrupted.
+class SimulationServer
+{
+
+
+public:
+	SimulationServer(int argc, char **argv);
+	int run();
+	static bool wanted(int argc, char **argv);
+
+private:
+	void apply(InputLog::Record const &record, Simulation &simulation, SimulationThread &thread,
+	           Visualization &visualization);
+	bool pin();
+
+	std::string name;					//of the fields, the input queue is name + "-input"
+	std::vector<int> cpus;				//cores to run on, all if empty
+	float steps_per_second;
+	CommandQueue commands;
+
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "simulationthread.hpp"
+
+
+SimulationThread::SimulationThread(Simulation &simulation, Scheduler &scheduler) : simulation(simulation), scheduler(scheduler), active(false)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+	stop();
+}
+
+void SimulationThread::start()
+{
+	if (active) return;
+	scheduler.reset();
+	active = true;
+	thread = std::thread(&SimulationThread::run, this);
+}
+
+//stop: Finish the current step and join the thread. Needed before touching the solver from the GLUT thread,
+//      e.g. on reset.
+void SimulationThread::stop()
+{
+	if (!active) return;
+	active = false;
+	thread.join();
+}
+
+bool SimulationThread::running()
+{
+	return active;
+}
+
+void SimulationThread::run()
+{
+	Tracer::name_thread("solver");
+	while (active)
+	{
+		if (simulation.take_parameters().frozen)
+		{
+			scheduler.reset();
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+		int steps = scheduler.steps_due();
+		for (int k = 0; k < steps; k++)
+			simulation.do_one_simulation_step(scheduler.step_time(k));
+		if (!steps)
+			std::this_thread::sleep_for(std::chrono::duration<double>(scheduler.wait()));
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef SIMULATIONTHREAD_HPP
+#define SIMULATIONTHREAD_HPP
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "scheduler.hpp"
+#include "simulation.hpp"
+
+// Runs the solver on its own thread, at the rate set by the scheduler. Completed steps reach the visualization
+// through the simulation's frame buffer, so a slow frame does not stall the physics and vice versa.
+class SimulationThread 
+{
+
+
+public:
+	SimulationThread(Simulation &simulation, Scheduler &scheduler);
+	~SimulationThread();
+	void start();
+	void stop();
+	bool running();
+
+private:
+	void run();
+
+	Simulation &simulation;
+	Scheduler &scheduler;
+	std::thread thread;
+	std::atomic<bool> active;
+
+};
+
+#endif
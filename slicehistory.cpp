@@ -0,0 +1,265 @@
+#include "slicehistory.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "simulation.hpp"
+
+using namespace std;
+
+SliceHistory::SliceHistory() : on(false), next_keyframe(0), overflow(false), interval(1), clock(0), last_slot(-1),
+                               replica(NULL)
+{
+      memset(&logged, 0, sizeof(logged));
+}
+
+SliceHistory::~SliceHistory()
+{
+      delete replica;
+}
+
+
+//--- SOLVER SIDE --------------------------------------------------------------------------------------------------
+
+void SliceHistory::push(StepInput const &record)
+{
+      if (!queue.push(record)) overflow.store(true);
+}
+
+//input: Log a mouse event splatted into 'step'
+void SliceHistory::input(long step, InputEvent const &event, float brush_radius)
+{
+      StepInput record;
+      if (!on.load(memory_order_relaxed)) return;
+      memset(&record, 0, sizeof(record));
+      record.step = step;
+      record.splat = true;
+      record.x0 = event.x0; record.y0 = event.y0;
+      record.x1 = event.x1; record.y1 = event.y1;
+      record.dx = event.dx; record.dy = event.dy;
+      record.brush_radius = brush_radius;
+      push(record);
+}
+
+//begin_step: Log 'parameters', the ones the solver computes 'step' with, if they changed or a keyframe is due.
+//            Returns whether the frame of 'step' has to carry the forces, to become a keyframe.
+bool SliceHistory::begin_step(long step, SolverParameters const &parameters)
+{
+      StepInput record;
+      if (!on.load(memory_order_relaxed)) return false;
+      bool keyframe = step >= next_keyframe.load(memory_order_relaxed);
+      memset(&record, 0, sizeof(record));
+      record.step = step;
+      record.dt = parameters.dt;
+      record.visc = parameters.visc;
+      record.derivatives = parameters.derivatives;
+      if (keyframe || record.dt != logged.dt || record.visc != logged.visc || record.derivatives != logged.derivatives)
+      {
+            push(record);
+            logged = record;
+      }
+      return keyframe;
+}
+
+
+//--- GLUT THREAD --------------------------------------------------------------------------------------------------
+
+//start: Start keeping a keyframe every 'interval' steps, or change the interval if already started
+void SliceHistory::start(int interval)
+{
+      this->interval = max(interval, 1);
+      if (on.load()) return;
+      clear();
+      on.store(true);
+}
+
+void SliceHistory::stop()
+{
+      on.store(false);
+      clear();
+}
+
+//clear: Forget all slices, and take the next frame that carries forces as the first keyframe
+void SliceHistory::clear()
+{
+      StepInput record;
+      while (queue.pop(record)) {}
+      overflow.store(false);
+      next_keyframe.store(0);
+      steps.clear();
+      keyframes.clear();
+      log.clear();
+      cache.clear();
+      used.clear();
+      last_slot = -1;
+}
+
+bool SliceHistory::active() const
+{
+      return on.load(memory_order_relaxed);
+}
+
+//receive: Take in the input the solver logged and a frame just received. The frame becomes the newest slice, and
+//         a keyframe when one is due; frames before the first keyframe cannot be rebuilt and are left out.
+void SliceHistory::receive(FieldSet const &frame, int number_of_slices)
+{
+      StepInput record;
+      while (queue.pop(record)) log.push_back(record);
+      if (overflow.load()) clear();     //a step is incomplete, nothing before it can be rebuilt
+
+      if (frame.forces && frame.step >= next_keyframe.load())
+      {
+            Keyframe keyframe;
+            size_t found = log.size();     //the parameters of the frame, logged at or before its step
+            for (size_t e = 0; e < log.size() && log[e].step <= frame.step; e++)
+                  if (!log[e].splat) found = e;
+            if (found < log.size())
+            {
+                  keyframe.state.copy_from(frame);
+                  keyframe.parameters = log[found];
+                  keyframes.push_back(std::move(keyframe));
+                  next_keyframe.store(frame.step + interval);
+            }
+      }
+      if (keyframes.empty() || (steps.size() && frame.step <= steps.back())) return;
+
+      int slot = take_slot();
+      cache[slot].copy_from(frame);
+      if ((int)steps.size() < number_of_slices) steps.push_back(long(frame.step));
+      else steps.rotate() = frame.step;
+      while ((int)steps.size() > number_of_slices) steps.pop_front();
+
+      size_t drop = 0, keep = 0;        //keyframes and input before the one the oldest slice needs
+      while (drop + 1 < keyframes.size() && keyframes[drop + 1].state.step <= steps[0]) drop++;
+      keyframes.erase(keyframes.begin(), keyframes.begin() + drop);
+      while (keep < log.size() && log[keep].step <= keyframes[0].state.step) keep++;
+      log.erase(log.begin(), log.begin() + keep);
+}
+
+//truncate: Drop the slices after slice i, with their keyframes and input, as the solver is about to continue from
+//          slice i. The solver must not be running.
+void SliceHistory::truncate(int i)
+{
+      StepInput record;
+      long step = steps[i];
+      while (queue.pop(record)) log.push_back(record);
+      while ((int)steps.size() > i + 1) steps.pop_back();
+      while (keyframes.size() > 1 && keyframes.back().state.step > step) keyframes.pop_back();
+      while (!log.empty() && log.back().step > step) log.pop_back();
+      for (size_t c = 0; c < cache.size(); c++)
+            if (cache[c].step > step) cache[c].step = -1;
+      last_slot = -1;
+      next_keyframe.store(step + 1);    //a keyframe right away also logs the parameters the solver continues with
+}
+
+int SliceHistory::size() const
+{
+      return steps.size();
+}
+
+long SliceHistory::step(int i) const
+{
+      return steps[i];
+}
+
+//slice: Slice i, oldest first, rebuilt if it is not in the cache. Valid until a different slice is asked for.
+FieldSet const &SliceHistory::slice(int i)
+{
+      long step = steps[i];
+      if (last_slot < 0 || cache[last_slot].step != step)
+      {
+            last_slot = -1;
+            for (size_t c = 0; c < cache.size() && last_slot < 0; c++)
+                  if (cache[c].step == step) last_slot = c;
+            if (last_slot < 0) last_slot = rebuild(step);
+      }
+      used[last_slot] = ++clock;
+      return cache[last_slot];
+}
+
+//rebuild: Step from the nearest state before 'step' that has its forces, a keyframe or a slice in the cache, up to
+//         'step'. Every step on the way is cached too, as the slices before 'step' are usually drawn next.
+//         Returns the cache slot of 'step'.
+int SliceHistory::rebuild(long step)
+{
+      size_t k = keyframes.size() - 1, e = 0;
+      int slot = -1;
+      while (k > 0 && keyframes[k].state.step > step) k--;
+      FieldSet const *base = &keyframes[k].state;
+      if (base->step == step)
+      {
+            slot = take_slot();
+            cache[slot].copy_from(*base);
+            return slot;
+      }
+      for (size_t c = 0; c < cache.size(); c++)
+            if (cache[c].forces && cache[c].step > base->step && cache[c].step < step) base = &cache[c];
+
+      Simulation &solver = this->solver(base->n);
+      StepInput parameters = keyframes[k].parameters;
+      solver.load_state(*base);
+      while (e < log.size() && log[e].step <= keyframes[k].state.step) e++;
+      for (; e < log.size() && log[e].step <= base->step; e++)
+            if (!log[e].splat) parameters = log[e];
+      solver.parameters.derivatives = parameters.derivatives;     //the derivatives in 'base' were computed with
+
+      for (long s = base->step + 1; s <= step; s++)
+      {
+            for (; e < log.size() && log[e].step == s; e++)
+                  if (log[e].splat)
+                  {
+                        InputEvent event = {0, 0, log[e].x0, log[e].y0, log[e].x1, log[e].y1, log[e].dx, log[e].dy};
+                        solver.splat(event, log[e].brush_radius);
+                  }
+                  else parameters = log[e];
+            SolverParameters logged = solver.parameters;
+            logged.dt = parameters.dt;
+            logged.visc = parameters.visc;
+            logged.derivatives = parameters.derivatives;
+            solver.use_parameters(logged);
+            solver.advance(logged);
+
+            slot = take_slot();
+            cache[slot].copy_from(solver.fields);
+            cache[slot].step = s;
+            cache[slot].time = 0;
+      }
+      return slot;
+}
+
+//take_slot: A cache slot for a new slice: a new one while the cache is smaller than a keyframe interval, then the
+//           one used longest ago
+int SliceHistory::take_slot()
+{
+      size_t slot = cache.size();
+      if (cache.size() < (size_t)interval + 2)
+      {
+            cache.push_back(FieldSet());
+            used.push_back(0);
+      }
+      else slot = min_element(used.begin(), used.end()) - used.begin();
+      used[slot] = ++clock;
+      if (last_slot == (int)slot) last_slot = -1;
+      return slot;
+}
+
+//solver: The private solver for an n*n grid
+Simulation &SliceHistory::solver(int n)
+{
+      if (replica && replica->fields.n != n)
+      {
+            delete replica;
+            replica = NULL;
+      }
+      if (!replica) replica = new Simulation(n);
+      return *replica;
+}
+
+//bytes: Memory held by the keyframes, the cache and the input log
+size_t SliceHistory::bytes() const
+{
+      size_t total = log.capacity() * sizeof(StepInput);
+      for (size_t k = 0; k < keyframes.size(); k++) total += keyframes[k].state.total_bytes();
+      for (size_t c = 0; c < cache.size(); c++) total += cache[c].total_bytes();
+      return total;
+}
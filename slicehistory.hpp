@@ -0,0 +1,91 @@
+#ifndef SLICEHISTORY_HPP
+#define SLICEHISTORY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include <rfftw.h>              //the numerical simulation FFTW library
+
+#include "fieldset.hpp"
+#include "ring.hpp"
+#include "spscqueue.hpp"
+
+class Simulation;
+struct InputEvent;
+struct SolverParameters;
+
+// Slice history kept as a keyframe every few steps plus the input of every step, instead of a copy of every step.
+// The solver logs the mouse events and parameter changes of every step and copies the forces into the frames a
+// keyframe is due for; the GLUT thread keeps those frames as keyframes. A slice is rebuilt on demand by stepping a
+// private solver from the nearest keyframe before it, which gives the very same fields since the step is
+// deterministic. Rebuilt slices stay in a small cache, least recently used out first, so drawing the slices from
+// new to old rebuilds every stretch between two keyframes only once. That still costs a solver step per slice for
+// every display frame that draws all slices: memory is traded for time, and pays off for long, rarely drawn histories.
+class SliceHistory
+{
+
+
+public:
+	// What went into a step besides the fields: a mouse event, or the parameters it was computed with
+	struct StepInput
+	{
+		long step;				//step it went into
+		bool splat;				//a mouse event, otherwise parameters
+		float x0, y0, x1, y1;	//mouse event, as in InputEvent
+		fftw_real dx, dy;
+		float brush_radius;
+		float dt, visc;			//parameters
+		int derivatives;		//bit mask of the Simulation::Derivative fields computed
+	};
+
+	SliceHistory();
+	~SliceHistory();
+
+	void start(int interval);
+	void stop();
+	void clear();
+	bool active() const;
+	void receive(FieldSet const &frame, int number_of_slices);
+	void truncate(int i);
+	int size() const;
+	long step(int i) const;
+	FieldSet const &slice(int i);
+	size_t bytes() const;
+
+	void input(long step, InputEvent const &event, float brush_radius);     //solver side
+	bool begin_step(long step, SolverParameters const &parameters);
+
+private:
+	SliceHistory(const SliceHistory &);
+	SliceHistory &operator=(const SliceHistory &);
+	void push(StepInput const &record);
+	int rebuild(long step);
+	int take_slot();
+	Simulation &solver(int n);
+
+	struct Keyframe
+	{
+		FieldSet state;			//frame of the step, with its forces
+		StepInput parameters;	//parameters in effect at that step
+	};
+
+	std::atomic<bool> on;
+	std::atomic<long> next_keyframe;	//the solver copies the forces into the frames from this step on
+	std::atomic<bool> overflow;			//the solver could not log a step, the history must start over
+	SpscQueue<StepInput, 1024> queue;	//solver to GLUT thread
+	StepInput logged;					//parameters logged last, solver side
+
+	int interval;						//steps between two keyframes, GLUT thread from here on
+	Ring<long> steps;					//step of every slice, oldest first
+	std::vector<Keyframe> keyframes;	//oldest first, the first one at or before the oldest slice
+	std::vector<StepInput> log;			//input of the steps after the first keyframe, in step order
+	std::vector<FieldSet> cache;		//slices rebuilt or received lately
+	std::vector<unsigned long> used;	//per cache slot: time it was last used
+	unsigned long clock;
+	int last_slot;						//cache slot of the slice looked up last, -1 if none
+	Simulation *replica;				//solver the slices are rebuilt with, created when first needed
+
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "slicespill.hpp"
+
+#include <cstdio>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "fieldset.hpp"
+#include "util.hpp"
+
+using namespace std;
+
+SliceSpill::SliceSpill() : base(NULL), stride(0), size(0)
+{
+}
+
+SliceSpill::~SliceSpill()
+{
+      close();
+}
+
+//open: Create the scratch file, in the cache directory or else /var/tmp, with room for 'capacity' slices of an n*n
+//      grid. Both are on disk on most systems; /tmp is often a tmpfs, which would keep the slices in memory.
+bool SliceSpill::open(int n, int capacity)
+{
+      string dir = cache_dir();
+      if (dir.empty()) dir = "/var/tmp";
+      string path = dir + "/smoke-slices-XXXXXX";
+      long page = sysconf(_SC_PAGESIZE);
+
+      close();
+      int fd = mkstemp(&path[0]);
+      if (fd < 0) return false;
+      unlink(path.c_str());           //the mapping keeps the file alive, nothing is left behind
+      stride = (FieldSet::bytes_for(n) + page - 1) / page * page;
+      size = stride * capacity;
+      void *mapped = ftruncate(fd, size) ? MAP_FAILED : mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (mapped == MAP_FAILED)
+      {
+            fprintf(stderr, "Cannot create a %.1f MB slice file in %s\n", size / 1e6, dir.c_str());
+            size = 0;
+            return false;
+      }
+      base = (char*)mapped;
+      free_slots.clear();
+      for (int i = capacity - 1; i >= 0; i--) free_slots.push_back((fftw_real*)(base + i * stride));
+      return true;
+}
+
+//close: Drop the scratch file. No slice may still be attached to it.
+void SliceSpill::close()
+{
+      if (base) munmap(base, size);
+      base = NULL;
+      size = 0;
+      free_slots.clear();
+}
+
+bool SliceSpill::is_open() const
+{
+      return base != NULL;
+}
+
+//take: A free slot to attach a slice to, NULL if all are taken
+fftw_real *SliceSpill::take()
+{
+      if (free_slots.empty()) return NULL;
+      fftw_real *slot = free_slots.back();
+      free_slots.pop_back();
+      return slot;
+}
+
+//give: Return the slot of 'slice', which is about to be dropped
+void SliceSpill::give(FieldSet const &slice)
+{
+      evict(slice);
+      free_slots.push_back(const_cast<fftw_real*>(slice.data()));
+}
+
+void SliceSpill::prefetch(FieldSet const &slice) const
+{
+      madvise((void*)slice.data(), stride, MADV_WILLNEED);
+}
+
+//evict: Take the pages of 'slice' out of the resident set; they are read back from the page cache or the file
+//       the next time the slice is touched
+void SliceSpill::evict(FieldSet const &slice) const
+{
+      madvise((void*)slice.data(), stride, MADV_DONTNEED);
+}
@@ -0,0 +1,42 @@
+#ifndef SLICESPILL_HPP
+#define SLICESPILL_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <rfftw.h>              //the numerical simulation FFTW library
+
+class FieldSet;
+
+// Backing store for a slice history too long to keep in RAM: a memory-mapped scratch file with one page-aligned
+// slot per slice, which slices attach to instead of allocating. The file is unlinked as soon as it is created and
+// starts out sparse, so it only takes the disk space of the slices written to it and disappears with the process.
+// The owner bounds the resident set by evicting slices it is done with, and prefetches the ones it needs next.
+class SliceSpill
+{
+
+
+public:
+	SliceSpill();
+	~SliceSpill();
+	bool open(int n, int capacity);
+	void close();
+	bool is_open() const;
+
+	fftw_real *take();
+	void give(FieldSet const &slice);
+	void prefetch(FieldSet const &slice) const;
+	void evict(FieldSet const &slice) const;
+
+private:
+	SliceSpill(const SliceSpill &);
+	SliceSpill &operator=(const SliceSpill &);
+
+	char *base;						//the mapped file
+	size_t stride;					//bytes per slot, whole pages
+	size_t size;
+	std::vector<fftw_real*> free_slots;
+
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <atomic>
+
+// Bounded lock-free queue for a single producer and a single consumer thread.
+// SIZE must be a power of two; one slot is kept free to tell a full queue from an empty one.
+template <class T, int SIZE>
+class SpscQueue
+{
+
+public:
+	SpscQueue() : head(0), tail(0) {}
+
+	//push: Append an item, producer side. Returns false (and drops the item) when the queue is full
+	bool push(T const &item)
+	{
+		unsigned t = tail.load(std::memory_order_relaxed);
+		if (((t + 1) & MASK) == head.load(std::memory_order_acquire)) return false;
+		items[t] = item;
+		tail.store((t + 1) & MASK, std::memory_order_release);
+		return true;
+	}
+
+	//pop: Take the oldest item, consumer side. Returns false when the queue is empty
+	bool pop(T &item)
+	{
+		unsigned h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+		item = items[h];
+		head.store((h + 1) & MASK, std::memory_order_release);
+		return true;
+	}
+
+private:
+	static const unsigned MASK = SIZE - 1;
+
+	T items[SIZE];
+	std::atomic<unsigned> head;     //next item to pop, written by the consumer
+	std::atomic<unsigned> tail;     //next free slot, written by the producer
+};
+
+#endif
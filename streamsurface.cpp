@@ -1,23 +1,14 @@
 #include "streamsurface.hpp"
 
 
-Stream_Surface::Stream_Surface(Vector2 *seed_points)
+Stream_Surface::Stream_Surface(Vector2 const *seed_points)
 {
-      this->seed_points = copy_array(seed_points);
+      for(int i=0; i<SEED_POINTS;i++)
+      {
+            this->seed_points[i] = seed_points[i];
+      }
 }
 
 Stream_Surface::~Stream_Surface()
 {
 }
-
-
-Vector2* Stream_Surface::copy_array(Vector2 *arr)
-{
-      Vector2 *new_arr =  (Vector2*) malloc(8);
-      for(int i=0; i<8;i++)
-      {
-            new_arr[i] = arr[i];
-      }
-
-      return new_arr;
-}
\ No newline at end of file
@@ -12,11 +12,12 @@ class Stream_Surface
 
 
 public:
-	Vector2 *seed_points;
+	static const int SEED_POINTS = 8;		//points along the seed line of a surface
 
-	Stream_Surface(Vector2 *seed_points);
+	mutable Vector2 seed_points[SEED_POINTS];	//advected through the slices while the surface is drawn
+
+	Stream_Surface(Vector2 const *seed_points);
 	~Stream_Surface();
-	Vector2* copy_array(Vector2 *arr);
 };
 
-#endif
\ No newline at end of file
+#endif
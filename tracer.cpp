@@ -0,0 +1,129 @@
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "scheduler.hpp"
+
+using namespace std;
+
+struct TraceEvent
+{
+      const char *name;
+      char phase;             //'X' span, 's' 't' 'f' start, step and end of a flow
+      int thread;
+      long id;                //flow id
+      double time, duration;  //in seconds
+};
+
+static const int MAX_THREADS = 16;
+
+static atomic<bool> active(false);
+static atomic<int> busy(0);                   //threads between checking 'active' and finishing their event
+static TraceEvent *events = NULL;
+static size_t capacity = 0;
+static atomic<size_t> used(0);
+static double origin = 0;                     //time the recording started
+
+static atomic<int> threads(0);
+static const char *thread_names[MAX_THREADS];
+static thread_local int thread_id = -1;
+
+static int this_thread_id()
+{
+      if (thread_id < 0) thread_id = threads.fetch_add(1) % MAX_THREADS;
+      return thread_id;
+}
+
+//record: Append an event, unless not recording or the buffer is full
+static void record(const char *name, char phase, long id, double time, double duration)
+{
+      busy.fetch_add(1);
+      if (active.load())
+      {
+            size_t i = used.fetch_add(1, memory_order_relaxed);
+            if (i < capacity)
+            {
+                  TraceEvent &e = events[i];
+                  e.name = name; e.phase = phase; e.thread = this_thread_id(); e.id = id;
+                  e.time = time; e.duration = duration;
+            }
+      }
+      busy.fetch_sub(1);
+}
+
+//start: Start recording, with room for 'size' events
+bool Tracer::start(size_t size)
+{
+      if (active.load()) return true;
+      events = (TraceEvent*) malloc(size * sizeof(TraceEvent));
+      if (!events) return false;
+      capacity = size;
+      used.store(0);
+      origin = Scheduler::now();
+      active.store(true);
+      return true;
+}
+
+//stop: Stop recording and write the events to 'path' as trace-event JSON
+bool Tracer::stop(const char *path)
+{
+      if (!active.load()) return false;
+      active.store(false);
+      while (busy.load()) this_thread::yield();   //let the other threads finish the event they are writing
+
+      size_t n = min(used.load(), capacity);
+      FILE *out = fopen(path, "w");
+      if (out)
+      {
+            fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+            for (int t = 0; t < min(threads.load(), MAX_THREADS); t++)
+                  fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                          t, thread_names[t] ? thread_names[t] : "thread");
+            for (size_t i = 0; i < n; i++)
+            {
+                  TraceEvent const &e = events[i];
+                  fprintf(out, "{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f", e.name, e.phase, e.thread,
+                          (e.time - origin) * 1e6);
+                  if (e.phase == 'X') fprintf(out, ",\"dur\":%.3f,\"cat\":\"phase\"", e.duration * 1e6);
+                  else fprintf(out, ",\"id\":%ld,\"cat\":\"input\"%s", e.id, e.phase == 'f' ? ",\"bp\":\"e\"" : "");
+                  fprintf(out, "}%s\n", i + 1 < n ? "," : "");
+            }
+            fprintf(out, "]}\n");
+            fclose(out);
+      }
+      if (used.load() > capacity)
+            fprintf(stderr, "Trace buffer full, dropped %lu events\n", (unsigned long)(used.load() - capacity));
+
+      free(events);
+      events = NULL;
+      capacity = 0;
+      return out != NULL;
+}
+
+bool Tracer::recording()
+{
+      return active.load(memory_order_relaxed);
+}
+
+//name_thread: Name the calling thread in the traces
+void Tracer::name_thread(const char *name)
+{
+      thread_names[this_thread_id()] = name;
+}
+
+//span: Record that the calling thread spent begin..end (seconds, Scheduler::now() clock) in 'name'
+void Tracer::span(const char *name, double begin, double end)
+{
+      record(name, 'X', 0, begin, end - begin);
+}
+
+//flow: Record the start ('s'), a step ('t') or the end ('f') of the flow 'id' in the calling thread. Steps and
+//      ends attach to the span that encloses them.
+void Tracer::flow(char phase, const char *name, long id, double time)
+{
+      record(name, phase, id, time, 0);
+}
@@ -0,0 +1,25 @@
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <cstddef>
+
+// Timeline of the phases of every thread, written as Chrome trace-event JSON (load it in chrome://tracing or
+// Perfetto). While a trace is recording, every Profiler timer adds a span. Mouse events are followed with flow
+// events from the GLUT thread into the solver step that applies them and on to the first frame that shows them.
+// Events go into a buffer allocated when recording starts, so recording does not allocate on the hot path;
+// events beyond its capacity are dropped.
+class Tracer
+{
+
+
+public:
+	static bool start(size_t capacity = 1 << 20);
+	static bool stop(const char *path);
+	static bool recording();
+	static void name_thread(const char *name);
+	static void span(const char *name, double begin, double end);
+	static void flow(char phase, const char *name, long id, double time);
+
+};
+
+#endif
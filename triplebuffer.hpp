@@ -0,0 +1,54 @@
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <atomic>
+
+// Lock-free triple buffer for one writer and one reader. The writer fills the back buffer and publishes it,
+// the reader picks up the most recently published buffer. Neither side ever waits for the other:
+// unread buffers are simply overwritten by newer ones. The reader also holds on to the buffer it had
+// before the current front buffer (so there are four buffers in total), which allows interpolating
+// between the last two states it received.
+template <class T>
+class TripleBuffer
+{
+
+public:
+	TripleBuffer() : back(0), middle(1), front(2), previous(3) {}
+
+	T &back_buffer() { return buffers[back]; }                         //writer side
+	T const &front_buffer() const { return buffers[front]; }           //reader side
+	T const &previous_buffer() const { return buffers[previous]; }     //reader side, the front buffer before the last update
+
+	//publish: Hand the back buffer to the reader and take the stale middle buffer as the new back buffer
+	void publish()
+	{
+		back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	//update: Swap in the latest published buffer as front buffer. Returns false if nothing new was published
+	bool update()
+	{
+		if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+		int stale = previous;
+		previous = front;
+		front = middle.exchange(stale, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	//buffer: Direct access to all buffers, only for (re)initialization while no writer or reader is active
+	T &buffer(int i) { return buffers[i]; }
+
+	static const int SIZE = 4;
+
+private:
+	static const int INDEX = 3;     //buffer index bits of 'middle'
+	static const int FRESH = 4;     //set when 'middle' holds a buffer the reader has not seen yet
+
+	T buffers[SIZE];
+	int back;
+	std::atomic<int> middle;
+	int front;
+	int previous;
+};
+
+#endif
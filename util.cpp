@@ -1,5 +1,8 @@
 #include "util.hpp"
 
+#include <cstdlib>
+#include <sys/stat.h>
+
 int clamp(float x)
 { return ((x)>=0.0?((int)(x)):(-((int)(1-(x))))); }
 
@@ -11,4 +14,21 @@ float clamp(float value, float min, float max)
 float rad2deg(float x)
 {
 	return x * (180/M_PI);
-}
\ No newline at end of file
+}
+
+//cache_dir: Directory for the files the program keeps between runs or spills to disk, $XDG_CACHE_HOME/smoke or
+//           ~/.cache/smoke, created if needed. Returns an empty string if it cannot be created.
+std::string cache_dir()
+{
+	const char *cache = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+	std::string dir;
+
+	if (cache && *cache) dir = cache;
+	else if (home && *home) dir = std::string(home) + "/.cache";
+	else return "";
+	mkdir(dir.c_str(), 0755);
+	dir += "/smoke";
+	mkdir(dir.c_str(), 0755);
+	struct stat info;
+	return stat(dir.c_str(), &info) == 0 && S_ISDIR(info.st_mode) ? dir : "";
+}
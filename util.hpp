@@ -2,10 +2,12 @@
 #define UTIL_HPP
 
 #include <cmath>
+#include <string>
 
 
 int clamp(float x);
 float clamp(float value, float min, float max);
 float rad2deg(float x);
+std::string cache_dir();
 
 #endif
\ No newline at end of file
@@ -4,6 +4,9 @@
 
 Visualization::Visualization()
 {
+    glut = true;
+    maxima_scalar = -1;
+    maxima_newest = 0;
     init_parameters();
 }
 
@@ -17,6 +20,7 @@ void Visualization::init_parameters()
     selected_stream = StreamLine;
     options[Slices] = false;
     options[Scaling] = false;
+    options[Timings] = false;
     selected_colormap = Rainbow;
     selected_scalar = VelocityScalar;
     selected_vector = VelocityVector;
@@ -64,6 +68,7 @@ void Visualization::fire(float value,float* R,float* G,float* B)
 //set_colormap: Sets three different types of colormaps
 void Visualization::set_colormap(Simulation const &simulation, int idx, float min_value, float max_value, int z)
 {
+    FieldSet const &frame = simulation.frame(); // latest completed step
     // if(vy!=0 && vy <0) cout << vy <<"\n";
     float value, R,G,B;
 
@@ -74,10 +79,10 @@ void Visualization::set_colormap(Simulation const &simulation, int idx, float mi
         {
             if(options[Slices]) 
             {
-                value = simulation.slices[z].rho[idx];
+                value = simulation.slice(z).rho[idx];
             } else 
             {
-                value = simulation.rho[idx];
+                value = frame.rho[idx];
             }
         }
         break;
@@ -85,10 +90,10 @@ void Visualization::set_colormap(Simulation const &simulation, int idx, float mi
         {
             if(options[Slices]) 
             {
-                value = sqrt(simulation.slices[z].vx[idx]*simulation.slices[z].vx[idx] + simulation.slices[z].vy[idx]*simulation.slices[z].vy[idx])*10;
+                value = sqrt(simulation.slice(z).vx[idx]*simulation.slice(z).vx[idx] + simulation.slice(z).vy[idx]*simulation.slice(z).vy[idx])*10;
             } else 
             {
-                value = sqrt(simulation.vx[idx]*simulation.vx[idx] + simulation.vy[idx]*simulation.vy[idx])*10;
+                value = sqrt(frame.vx[idx]*frame.vx[idx] + frame.vy[idx]*frame.vy[idx])*10;
             }
         }
         break;
@@ -96,10 +101,32 @@ void Visualization::set_colormap(Simulation const &simulation, int idx, float mi
         {
             if(options[Slices]) 
             {
-                value = sqrt(simulation.slices[z].fx[idx]*simulation.slices[z].fx[idx] + simulation.slices[z].fy[idx]*simulation.slices[z].fy[idx])*10;
+                value = sqrt(simulation.slice(z).fx[idx]*simulation.slice(z).fx[idx] + simulation.slice(z).fy[idx]*simulation.slice(z).fy[idx])*10;
             } else 
             {
-                value = sqrt(simulation.fx[idx]*simulation.fx[idx] + simulation.fy[idx]*simulation.fy[idx])*10;
+                value = sqrt(frame.fx[idx]*frame.fx[idx] + frame.fy[idx]*frame.fy[idx])*10;
+            }
+        }
+        break;
+        case VorticityScalar:
+        {
+            if(options[Slices]) 
+            {
+                value = fabs(simulation.slice(z).vorticity[idx])*10;
+            } else 
+            {
+                value = fabs(frame.vorticity[idx])*10;
+            }
+        }
+        break;
+        case DivergenceScalar:
+        {
+            if(options[Slices]) 
+            {
+                value = fabs(simulation.slice(z).divergence[idx])*10;
+            } else 
+            {
+                value = fabs(frame.divergence[idx])*10;
             }
         }
         break;
@@ -107,10 +134,10 @@ void Visualization::set_colormap(Simulation const &simulation, int idx, float mi
         {
             if(options[Slices]) 
             {
-                value = simulation.slices[z].rho[idx];
+                value = simulation.slice(z).rho[idx];
             } else 
             {
-                value = simulation.rho[idx];
+                value = frame.rho[idx];
             }
         }
     }
@@ -208,11 +235,30 @@ void Visualization::direction_to_color(float f, float min_value, float max_value
     }
 }
 
-void Visualization::draw_string(string text, int x, int y)
+void Visualization::draw_string(const char *text, int x, int y)
 {
+    if (!glut) return;
     glRasterPos2i(x,y);
-    for(int i = 0; i < (int) text.length(); i++){ 
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, text.data()[i]);
+    for(; *text; text++){ 
+        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, *text);
+    }
+}
+
+//draw_timings: Overlay the rolling average and 99th percentile time of every phase in the top left corner
+void Visualization::draw_timings(int winWidth, int winHeight)
+{
+    char line[64];
+    int y = winHeight - 20;
+
+    glColor3f(1,1,1);
+    draw_string("phase            avg ms   p99 ms", 10, y);
+    for(int p = 0; p < Profiler::PhaseSize; p++)
+    {
+        float average, p99;
+        Profiler::summary((Profiler::Phase)p, &average, &p99);
+        snprintf(line, sizeof(line), "%-15s %7.3f  %7.3f", Profiler::names[p], average, p99);
+        y -= 15;
+        draw_string(line, 10, y);
     }
 }
 
@@ -257,18 +303,18 @@ void Visualization::draw_gradient(int nrRect, int winWidth, int winHeight, float
     if(max<min) {
         max = min;  // min cannot exceed max, clamp_min might be bigger than the max value in the field
     }
-    ostringstream string_min;
-    string_min << min;
-    draw_string(string_min.str(), winWidth/4,barHeight+bottomSpace+5);
-    ostringstream string_max;
-    string_max << max;
-    draw_string(string_max.str(), 3*winWidth/4,barHeight+bottomSpace+5);
+    char label[32]; // formatted on the stack, a stream would allocate every frame
+    snprintf(label, sizeof(label), "%g", min);
+    draw_string(label, winWidth/4,barHeight+bottomSpace+5);
+    snprintf(label, sizeof(label), "%g", max);
+    draw_string(label, 3*winWidth/4,barHeight+bottomSpace+5);
     
 
 }
 // Display color legend for current colormap
 void Visualization::display_legend(int winWidth, int winHeight, float min_value, float max_value)
 {
+    Profiler::Timer timer(Profiler::Legend);
 
     switch(selected_colormap)
     {
@@ -293,6 +339,7 @@ void Visualization::display_legend(int winWidth, int winHeight, float min_value,
 
 void Visualization::draw_smoke(Simulation const &simulation, fftw_real wn, fftw_real hn, float min_value, float max_value, int z)
 {
+    Profiler::Timer timer(Profiler::Smoke);
     const int DIM = Simulation::DIM;
     double px,py;
     int i, j, idx;  
@@ -453,7 +500,7 @@ void Visualization::draw_glyphs(float value_x, float value_y, fftw_real wn, fftw
             glRotatef(270.0, 1.0, 0.0, 0.0);
 
 
-            glutSolidCone(3*multiplier+5, size*multiplier, 12,12);
+            if (glut) glutSolidCone(3*multiplier+5, size*multiplier, 12,12);
             glPopMatrix();
         } break;
         case Arrow:
@@ -481,6 +528,8 @@ void Visualization::draw_glyphs(float value_x, float value_y, fftw_real wn, fftw
 
 void Visualization::draw_streamlines(Simulation const &simulation, float winWidth, float winHeight, float wn, float hn, float min_value, float max_value, int z, float max_slices_value)
 {
+    Profiler::Timer timer(Profiler::Streamlines);
+    FieldSet const &frame = simulation.frame(); // latest completed step
     const size_t segments_per_line = Simulation::STREAMLINE_LENGTH;  // fixed max segments
 
     const float xscale = static_cast<float>(Simulation::DIM) / winWidth;
@@ -514,14 +563,14 @@ void Visualization::draw_streamlines(Simulation const &simulation, float winWidt
 
             size_t idx = j * (Simulation::DIM-1) + i;
             // velocity at nearest grid location
-            Vector2 velocity = Vector2(simulation.vx[idx], simulation.vy[idx]);
+            Vector2 velocity = Vector2(frame.vx[idx], frame.vy[idx]);
 
             if (velocity.length() > 0) // don't divide by zero
                 velocity.normalize();
 
             p1 = p0 + velocity*5;
 
-            float f = sqrt(simulation.vx[idx]*simulation.vx[idx] + simulation.vy[idx]*simulation.vy[idx]) * 10;
+            float f = sqrt(frame.vx[idx]*frame.vx[idx] + frame.vy[idx]*frame.vy[idx]) * 10;
 
             direction_to_color(f, min_value, max_value, max_slices_value);
 
@@ -548,8 +597,11 @@ void Visualization::draw_streamlines(Simulation const &simulation, float winWidt
     }
 }
 
-void Visualization::draw_streamsurfaces(Simulation const &simulation, float winWidth, float winHeight, float wn, float hn, float min_value, float max_value)
+//draw_streamsurfaces: Draw the part of every stream surface that lies in slice j, and move the surfaces on to the
+//                     slice before it. Called for every slice from new to old, along with the rest of the slice.
+void Visualization::draw_streamsurfaces(Simulation const &simulation, float winWidth, float winHeight, float wn, float hn, float min_value, float max_value, int j)
 {
+    Profiler::Timer timer(Profiler::Surfaces);
     float window_correction = (winWidth-200)*0.0015625; 
     const float xscale = static_cast<float>(Simulation::DIM) / winWidth;
     const float yscale = static_cast<float>(Simulation::DIM) / winHeight;
@@ -557,7 +609,6 @@ void Visualization::draw_streamsurfaces(Simulation const &simulation, float winW
     for (int i = 0; i < simulation.stream_surfaces.size(); ++i)
     {
 
-        for(int j=simulation.slices.size()-1; j>=0;j--) 
         {
 
 
@@ -581,7 +632,7 @@ void Visualization::draw_streamsurfaces(Simulation const &simulation, float winW
 
                 size_t idx = jj * (Simulation::DIM-1) + ii;
                 // velocity at nearest grid location
-                Vector2 velocity = Vector2(simulation.slices[j].vx[idx], simulation.slices[j].vy[idx]);
+                Vector2 velocity = Vector2(simulation.slice(j).vx[idx], simulation.slice(j).vy[idx]);
 
                 // cout << "\nbe4 normalize" << velocity.x;
 
@@ -606,7 +657,7 @@ void Visualization::draw_streamsurfaces(Simulation const &simulation, float winW
 
                     idx = jj * (Simulation::DIM-1) + ii;
                     // velocity at nearest grid location
-                    velocity = Vector2(simulation.slices[j].vx[idx], simulation.slices[j].vy[idx]);
+                    velocity = Vector2(simulation.slice(j).vx[idx], simulation.slice(j).vy[idx]);
 
                     if (velocity.length() > 0) velocity.normalize();
                     
@@ -660,6 +711,7 @@ void Visualization::draw_streamsurfaces(Simulation const &simulation, float winW
 
 void Visualization::apply_scaling(Simulation const &simulation, float *min_value, float *max_value)
 {
+    FieldSet const &frame = simulation.frame(); // latest completed step
     const int DIM = Simulation::DIM;
     *max_value=0;
     *min_value=10;
@@ -671,16 +723,24 @@ void Visualization::apply_scaling(Simulation const &simulation, float *min_value
         {
             case DensityScalar: 
             {
-                value = simulation.rho[i];
+                value = frame.rho[i];
             } break;
             case VelocityScalar: 
             {
-                value = sqrt(simulation.vy[i]*simulation.vy[i]+simulation.vx[i]*simulation.vx[i])*10;
+                value = sqrt(frame.vy[i]*frame.vy[i]+frame.vx[i]*frame.vx[i])*10;
 
             } break;
             case ForceScalar: 
             {
-                value = sqrt(simulation.fy[i]*simulation.fy[i]+simulation.fx[i]*simulation.fx[i])*10;
+                value = sqrt(frame.fy[i]*frame.fy[i]+frame.fx[i]*frame.fx[i])*10;
+            } break;
+            case VorticityScalar: 
+            {
+                value = fabs(frame.vorticity[i])*10;
+            } break;
+            case DivergenceScalar: 
+            {
+                value = fabs(frame.divergence[i])*10;
             } break;
         }
 
@@ -696,6 +756,7 @@ void Visualization::apply_scaling(Simulation const &simulation, float *min_value
 }
 void Visualization::draw_vectors(fftw_real *dataset_x_scalar, fftw_real *dataset_y_scalar, fftw_real *dataset_x_vector, fftw_real *dataset_y_vector, fftw_real wn, fftw_real hn, float min_value, float max_value, int z, float max_slices_value)
 {
+    Profiler::Timer timer(Profiler::Glyphs);
     int i,j;
     for (i = 0; i < number_of_glyphs_x; i++)
     {
@@ -708,6 +769,8 @@ void Visualization::draw_vectors(fftw_real *dataset_x_scalar, fftw_real *dataset
             float f;
             if(selected_scalar==DensityScalar) {
                 f = value_x;
+            } else if(selected_scalar==VorticityScalar || selected_scalar==DivergenceScalar) {
+                f = fabs(value_x)*10;
             } else {
                 f =  sqrt(value_y*value_y+value_x*value_x)*10;
             }
@@ -716,6 +779,12 @@ void Visualization::draw_vectors(fftw_real *dataset_x_scalar, fftw_real *dataset
 
             if (selected_vector != GradientVector) 
                 interpolation(dataset_x_vector, dataset_y_vector, i,j, &value_x, &value_y, &glyph_point_x, &glyph_point_y);
+            else if (dataset_x_vector) // spectral gradient from the solver
+            {
+                interpolation(dataset_x_vector, dataset_y_vector, i,j, &value_x, &value_y, &glyph_point_x, &glyph_point_y);
+                value_x /= max_value * 2.5; // same scale as the two-cell difference in vector_gradient
+                value_y /= max_value * 2.5;
+            }
             else
                 vector_gradient(dataset_x_scalar, dataset_y_scalar, i, j, &value_x, &value_y, &glyph_point_x, &glyph_point_y, max_value);
             draw_glyphs(value_x, value_y, wn, hn, glyph_point_x, glyph_point_y, z);
@@ -723,9 +792,70 @@ void Visualization::draw_vectors(fftw_real *dataset_x_scalar, fftw_real *dataset
     }
 }
 
+//slice_max: Largest value of the selected scalar in slice z, as the slices' glyphs and streamlines are scaled by
+float Visualization::slice_max(Simulation const &simulation, int z)
+{
+    FieldSet const &slice = simulation.slice(z);
+    fftw_real *dataset_x_scalar = slice.vx, *dataset_y_scalar = slice.vy;
+    float max_value = 0;
+    switch(selected_scalar)
+    {
+        case DensityScalar: dataset_x_scalar=slice.rho; dataset_y_scalar=slice.rho; break;
+        case VorticityScalar: dataset_x_scalar=slice.vorticity; dataset_y_scalar=slice.vorticity; break;
+        case DivergenceScalar: dataset_x_scalar=slice.divergence; dataset_y_scalar=slice.divergence; break;
+        case VelocityScalar: dataset_x_scalar=slice.vx; dataset_y_scalar=slice.vy; break;
+        case ForceScalar: dataset_x_scalar=slice.fx; dataset_y_scalar=slice.fy; break;
+    }
+    for(int j= 0; j<Simulation::DIM*Simulation::DIM;j++)
+    {
+        float f;
+        if(selected_scalar==DensityScalar) {
+            f = dataset_x_scalar[j];
+        } else {
+            f = atan2(dataset_y_scalar[j],dataset_x_scalar[j]) / M_PI + 1;
+        }
+        if(f>max_value) max_value = f;
+    }
+    return max_value;
+}
+
+//slices_max: Largest value of the selected scalar over all slices. The maximum of every slice is kept by its step,
+//            so a slice is only read for it when it first shows up; the slices are then read once per frame, to
+//            draw them, which matters when they are rebuilt from keyframes. The maxima are forgotten when the
+//            scalar changes or the steps go back (a reset, or resuming from a slice).
+float Visualization::slices_max(Simulation const &simulation)
+{
+    int count = simulation.slice_count();
+    float max_value = 0;
+    size_t k = 0;
+
+    if (selected_scalar != maxima_scalar || (count && simulation.slice_step(count - 1) < maxima_newest))
+        maxima.clear();
+    maxima_scalar = selected_scalar;
+    maxima_newest = count ? simulation.slice_step(count - 1) : 0;
+    fresh_maxima.clear();
+    for (int i = count - 1; i >= 0; i--)      //from new to old, as the slices are drawn
+    {
+        long step = simulation.slice_step(i);
+        while (k < maxima.size() && maxima[k].first > step) k++;
+        float value;
+        if (k < maxima.size() && maxima[k].first == step) value = maxima[k].second;
+        else
+        {
+            value = slice_max(simulation, i);
+            simulation.release_slice(i);
+        }
+        fresh_maxima.push_back(make_pair(step, value));
+        if (value > max_value) max_value = value;
+    }
+    maxima.swap(fresh_maxima);
+    return max_value;
+}
+
 //visualize: This is the main visualization function
 void Visualization::visualize(Simulation const &simulation, int winWidth, int winHeight)
 {
+    FieldSet const &frame = simulation.frame(); // latest completed step
     const int DIM = Simulation::DIM;
     fftw_real  wn = (fftw_real)winWidth / (fftw_real)(DIM + 1);   // Grid cell width
     fftw_real  hn = (fftw_real)winHeight / (fftw_real)(DIM + 1);  // Grid cell heigh
@@ -739,79 +869,57 @@ void Visualization::visualize(Simulation const &simulation, int winWidth, int wi
 
     if(options[Slices])
     {
-        float max_slices_value=0;
-        for(int i=simulation.slices.size()-1; i>=0;i--) 
-        {
-            fftw_real *dataset_x_scalar, *dataset_y_scalar;
-            switch(selected_scalar)
-            {
-                case DensityScalar: 
-                {
-                    dataset_x_scalar=simulation.slices[i].rho; dataset_y_scalar=simulation.slices[i].rho;
-                } break;
-                case VelocityScalar: 
-                {
-                    dataset_x_scalar=simulation.slices[i].vx; dataset_y_scalar=simulation.slices[i].vy;
-                } break;
-                case ForceScalar: 
-                {
-                    dataset_x_scalar=simulation.slices[i].fx; dataset_y_scalar=simulation.slices[i].fy;
-                } break;
-            }
-            for(int j= 0; j<DIM*DIM;j++)
-            {
-
-                float f;
-                if(selected_scalar==DensityScalar) {
-                    f = dataset_x_scalar[j];
-                } else {
-                    f = atan2(dataset_y_scalar[j],dataset_x_scalar[j]) / M_PI + 1;
-                }
-                if(f>max_slices_value) max_slices_value = f;
+        float max_slices_value=slices_max(simulation);
 
-            }
-        }
-
-        for(int i=simulation.slices.size()-1; i>=0;i--) 
+        for(int i=simulation.slice_count()-1; i>=0;i--) 
         {
+            simulation.prefetch_slice(i-Simulation::PREFETCH_SLICES);
             if (options[DrawSmoke])
             {
                 draw_smoke(simulation,wn,hn, min_value, max_value,i);
             }
             if(options[DrawVecs])
             {
-                fftw_real *dataset_x_scalar, *dataset_y_scalar, *dataset_x_vector, *dataset_y_vector;
+                fftw_real *dataset_x_scalar, *dataset_y_scalar, *dataset_x_vector = NULL, *dataset_y_vector = NULL;
                 switch(selected_scalar)
                 {
                     case DensityScalar: 
                     {
-                        dataset_x_scalar=simulation.slices[i].rho; dataset_y_scalar=simulation.slices[i].rho;
+                        dataset_x_scalar=simulation.slice(i).rho; dataset_y_scalar=simulation.slice(i).rho;
+                    } break;
+                    case VorticityScalar: 
+                    {
+                        dataset_x_scalar=simulation.slice(i).vorticity; dataset_y_scalar=simulation.slice(i).vorticity;
+                    } break;
+                    case DivergenceScalar: 
+                    {
+                        dataset_x_scalar=simulation.slice(i).divergence; dataset_y_scalar=simulation.slice(i).divergence;
                     } break;
                     case VelocityScalar: 
                     {
-                        dataset_x_scalar=simulation.slices[i].vx; dataset_y_scalar=simulation.slices[i].vy;
+                        dataset_x_scalar=simulation.slice(i).vx; dataset_y_scalar=simulation.slice(i).vy;
                     } break;
                     case ForceScalar: 
                     {
-                        dataset_x_scalar=simulation.slices[i].fx; dataset_y_scalar=simulation.slices[i].fy;
+                        dataset_x_scalar=simulation.slice(i).fx; dataset_y_scalar=simulation.slice(i).fy;
                     } break;
                 }
 
                 switch(selected_vector)
                 {
-                    case VelocityVector: {dataset_x_vector=simulation.slices[i].vx; dataset_y_vector=simulation.slices[i].vy;} break;
-                    case ForceVector: {dataset_x_vector=simulation.slices[i].fx; dataset_y_vector=simulation.slices[i].fy;} break;
+                    case VelocityVector: {dataset_x_vector=simulation.slice(i).vx; dataset_y_vector=simulation.slice(i).vy;} break;
+                    case ForceVector: {dataset_x_vector=simulation.slice(i).fx; dataset_y_vector=simulation.slice(i).fy;} break;
                 }
 
                 draw_vectors(dataset_x_scalar, dataset_y_scalar, dataset_x_vector, dataset_y_vector, wn, hn, min_value, max_value, i, max_slices_value);
             }
             if (selected_stream==StreamLine) draw_streamlines(simulation,winWidth, winHeight, wn, hn, min_value, max_value, i, max_slices_value); 
+            if (selected_stream==StreamSurface) draw_streamsurfaces(simulation,winWidth, winHeight, wn, hn, min_value, max_value, i);
+            simulation.release_slice(i);
 
 
         }
 
-        if(selected_stream==StreamSurface) draw_streamsurfaces(simulation,winWidth, winHeight, wn, hn, min_value, max_value);
-        
 
     } else {
         if (options[DrawSmoke])
@@ -822,27 +930,42 @@ void Visualization::visualize(Simulation const &simulation, int winWidth, int wi
         if (options[DrawVecs])
         {
 
-            fftw_real *dataset_x_scalar, *dataset_y_scalar, *dataset_x_vector, *dataset_y_vector;
+            fftw_real *dataset_x_scalar, *dataset_y_scalar, *dataset_x_vector = NULL, *dataset_y_vector = NULL;
             switch(selected_scalar)
             {
                 case DensityScalar: 
                 {
-                    dataset_x_scalar=simulation.rho; dataset_y_scalar=simulation.rho;
+                    dataset_x_scalar=frame.rho; dataset_y_scalar=frame.rho;
+                } break;
+                case VorticityScalar: 
+                {
+                    dataset_x_scalar=frame.vorticity; dataset_y_scalar=frame.vorticity;
+                } break;
+                case DivergenceScalar: 
+                {
+                    dataset_x_scalar=frame.divergence; dataset_y_scalar=frame.divergence;
                 } break;
                 case VelocityScalar: 
                 {
-                    dataset_x_scalar=simulation.vx; dataset_y_scalar=simulation.vy;
+                    dataset_x_scalar=frame.vx; dataset_y_scalar=frame.vy;
                 } break;
                 case ForceScalar: 
                 {
-                    dataset_x_scalar=simulation.fx; dataset_y_scalar=simulation.fy;
+                    dataset_x_scalar=frame.fx; dataset_y_scalar=frame.fy;
                 } break;
             }
 
             switch(selected_vector)
             {
-                case VelocityVector: {dataset_x_vector=simulation.vx; dataset_y_vector=simulation.vy;} break;
-                case ForceVector: {dataset_x_vector=simulation.fx; dataset_y_vector=simulation.fy;} break;
+                case VelocityVector: {dataset_x_vector=frame.vx; dataset_y_vector=frame.vy;} break;
+                case ForceVector: {dataset_x_vector=frame.fx; dataset_y_vector=frame.fy;} break;
+                case GradientVector: 
+                {
+                    if(selected_scalar==DensityScalar && simulation.derivatives[Simulation::DensityGradient])
+                    {
+                        dataset_x_vector=frame.grad_x; dataset_y_vector=frame.grad_y;
+                    }
+                } break;
             }
 
             draw_vectors(dataset_x_scalar, dataset_y_scalar, dataset_x_vector, dataset_y_vector, wn, hn, min_value, max_value, 0, 1);
@@ -853,6 +976,7 @@ void Visualization::visualize(Simulation const &simulation, int winWidth, int wi
     glDisable (GL_LIGHTING);
     glPopMatrix(); // Pop in order to not let the transformations affect the legend
     display_legend(winWidth, winHeight, min_value, max_value);
+    if (options[Timings]) draw_timings(winWidth, winHeight);
 
 }
 
@@ -882,6 +1006,12 @@ void Visualization::disable(Option option)
     options[option] = false;
 }
 
+// shows_forces: Does the current view draw the force field
+bool Visualization::shows_forces() 
+{
+    return selected_scalar == ForceScalar || selected_vector == ForceVector;
+}
+
 
 
 // void Visualization::toggle_scalarcol()
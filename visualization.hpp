@@ -5,11 +5,12 @@
 #include <cmath>
 #include <GL/glut.h>
 #include <rfftw.h>              //the numerical simulation FFTW library
-#include <sstream>     // for ostringstream
+#include <cstdio>      // for snprintf
 #include <string>
 #include <vector>
 #include <iostream>
 
+#include "profiler.hpp"
 #include "simulation.hpp"
 #include "util.hpp"
 #include "vector2.hpp"
@@ -21,6 +22,8 @@ class Simulation;
 class Visualization {
 
 friend class Fluids;
+friend class Bench;
+friend class InputLog;
 
 public:
 
@@ -30,6 +33,7 @@ public:
 		DrawVecs,       //draw the vector field or not
 		Scaling,		//apply scaling or not
 		Slices, 		//draw slices or not
+		Timings,		//draw the timing overlay or not
 		OptionSize		//auto assigned (last in enum==size of enum)
 	};
 
@@ -45,7 +49,9 @@ public:
 	{
 		DensityScalar,
 		VelocityScalar,
-		ForceScalar
+		ForceScalar,
+		VorticityScalar,	//needs the solver's Vorticity derivative
+		DivergenceScalar	//needs the solver's Divergence derivative
 	};
 
 	enum VectorField // Different types of vector fields
@@ -78,6 +84,7 @@ public:
 	bool is_enabled(Option option);
 	void enable(Option option);
 	void disable(Option option);
+	bool shows_forces();
 
 	void change_hedgehog(double scale);
 	
@@ -100,6 +107,8 @@ public:
 
 	float number_of_opaque;
 
+	bool glut;					//GLUT is initialized, its text and shapes can be drawn; not so in smoke-bench
+
 
 
 private:
@@ -108,17 +117,24 @@ private:
 	void display_legend(int winWidth, int winHeight, float min_value, float max_value);
 	void direction_to_color(float f, float min_value, float max_value, float max_slices_value);
 
-	void draw_string(string text, int x, int y);
+	void draw_string(const char *text, int x, int y);
+	void draw_timings(int winWidth, int winHeight);
 	void draw_smoke(Simulation const &simulation, fftw_real wn, fftw_real hn, float min_value, float max_value, int z);
 	void interpolation(fftw_real *dataset_x, fftw_real* dataset_y, int i, int j, float *value_x, float *value_y, float *glyph_point_x, float *glyph_point_y);
 	void vector_gradient(fftw_real *dataset_x, fftw_real* dataset_y, int i, int j, float *value_x, float *value_y, float *glyph_point_x, float *glyph_point_y, float max_value);
 	void draw_glyphs(float value_x, float value_y, fftw_real wn, fftw_real hn, float glyph_point_x, float glyph_point_y, int z);
 	void draw_streamlines(Simulation const &simulation, float winWidth, float winHeight, float wn, float hn, float min_value, float max_value, int z, float max_slices_value);
-	void draw_streamsurfaces(Simulation const &simulation, float winWidth, float winHeight, float wn, float hn, float min_value, float max_value);
+	void draw_streamsurfaces(Simulation const &simulation, float winWidth, float winHeight, float wn, float hn, float min_value, float max_value, int j);
+	float slice_max(Simulation const &simulation, int z);
+	float slices_max(Simulation const &simulation);
 	void apply_scaling(Simulation const &simulation, float *min_value, float *max_value);
 	void draw_vectors(fftw_real *dataset_x_scalar, fftw_real *dataset_y_scalar, fftw_real *dataset_x_vector, fftw_real *dataset_y_vector, fftw_real wn, fftw_real hn,  float min_value, float max_value, int z, float max_slices_value);
 
 	int options[OptionSize];
+	vector<pair<long, float> > maxima;		//step and largest scalar value of every slice, newest first
+	vector<pair<long, float> > fresh_maxima;	//the same for the slices drawn now, swapped with maxima
+	int maxima_scalar;						//scalar field the maxima are of
+	long maxima_newest;						//step of the newest slice, when the maxima were taken
 
 	//--- VISUALIZATION PARAMETERS ---------------------------------------------------------------------
 
@@ -0,0 +1,233 @@
+#include "vtkexporter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "backgroundwriter.hpp"
+#include "fieldset.hpp"
+#include "simulation.hpp"
+
+using namespace std;
+
+// Arrays a snapshot can hold, in the order they are written
+enum Array
+{
+      VelocityX,
+      VelocityY,
+      Density,
+      Vorticity,
+      Divergence,
+      GradientX,
+      GradientY,
+      ArraySize               //auto assigned (last in enum==size of enum)
+};
+
+// A step copied by the solver, waiting for the writer thread
+struct Snapshot
+{
+      vector<fftw_real> values;               //ArraySize arrays of n*n values, or up to Density without derivatives
+      long step;
+      int derivatives;                        //bit mask of the Simulation::Derivative arrays it holds
+};
+
+static Snapshot snapshots[VtkExporter::SNAPSHOTS];
+static BackgroundWriter writer;               //writes the snapshots the solver hands over
+static int grid = 0, interval = 1;            //grid size, every how many steps to export
+static bool with_derivatives = false;
+
+static atomic<long> exported(0), dropped(0);
+
+static FILE *collection = NULL;               //writer side from here on
+static string stem, base;                     //path of the .pvd without extension, and its file name part
+static vector<fftw_real> buffer;              //interleaved vector components
+static uint64_t written_bytes = 0;
+static bool write_failed = false;
+
+static const char FOOTER[] = "  </Collection>\n</VTKFile>\n";
+
+
+//--- WRITER THREAD ------------------------------------------------------------------------------------------------
+
+static const char *byte_order()
+{
+      const uint16_t one = 1;
+      return *(const uint8_t*)&one ? "LittleEndian" : "BigEndian";
+}
+
+//add_array: Describe an array of 'components' values per point in the XML and reserve its place in the appended
+//           data, a UInt64 byte count followed by the values
+static void add_array(string &xml, uint64_t &offset, const char *name, int components)
+{
+      char line[256];
+      uint64_t bytes = (uint64_t)grid * grid * components * sizeof(fftw_real);
+      snprintf(line, sizeof(line), "        <DataArray type=\"%s\" Name=\"%s\" NumberOfComponents=\"%d\" "
+               "format=\"appended\" offset=\"%llu\"/>\n", sizeof(fftw_real) == 8 ? "Float64" : "Float32", name,
+               components, (unsigned long long)offset);
+      xml += line;
+      offset += sizeof(uint64_t) + bytes;
+}
+
+//write_array: Write an array to the appended data, interleaving the vector components (z is zero)
+static void write_array(FILE *out, const fftw_real *x, const fftw_real *y)
+{
+      size_t nn = (size_t)grid * grid;
+      uint64_t bytes = nn * (y ? 3 : 1) * sizeof(fftw_real);
+      const fftw_real *values = x;
+      if (y)
+      {
+            buffer.resize(3 * nn);
+            for (size_t i = 0; i < nn; i++)
+            {
+                  buffer[3 * i] = x[i];
+                  buffer[3 * i + 1] = y[i];
+                  buffer[3 * i + 2] = 0;
+            }
+            values = buffer.data();
+      }
+      write_failed |= fwrite(&bytes, sizeof(bytes), 1, out) != 1 || fwrite(values, 1, bytes, out) != bytes;
+      written_bytes += sizeof(bytes) + bytes;
+}
+
+//write_snapshot: Write the .vti file of a snapshot handed over by the solver and add it to the collection. The
+//                files are numbered in the order they are exported rather than by step, which starts over on a
+//                reset; the step is the timestep of the entry.
+static void write_snapshot(int index)
+{
+      Snapshot const &snapshot = snapshots[index];
+      size_t nn = (size_t)grid * grid;
+      const fftw_real *array[ArraySize];          //the derivatives are only there if they were exported
+      for (int a = 0; a < ArraySize; a++) array[a] = a <= Density || with_derivatives ? &snapshot.values[a * nn] : NULL;
+      bool vorticity = snapshot.derivatives >> Simulation::Vorticity & 1;
+      bool divergence = snapshot.derivatives >> Simulation::Divergence & 1;
+      bool gradient = snapshot.derivatives >> Simulation::DensityGradient & 1;
+
+      char name[64], header[512];
+      snprintf(name, sizeof(name), "_%06ld.vti", exported.load());
+      snprintf(header, sizeof(header), "<?xml version=\"1.0\"?>\n"
+               "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\">\n"
+               "  <ImageData WholeExtent=\"0 %d 0 %d 0 0\" Origin=\"0 0 0\" Spacing=\"1 1 1\">\n"
+               "    <Piece Extent=\"0 %d 0 %d 0 0\">\n"
+               "      <PointData Scalars=\"density\" Vectors=\"velocity\">\n",
+               byte_order(), grid - 1, grid - 1, grid - 1, grid - 1);
+      string xml = header;
+      uint64_t offset = 0;
+      add_array(xml, offset, "velocity", 3);
+      add_array(xml, offset, "density", 1);
+      if (vorticity) add_array(xml, offset, "vorticity", 1);
+      if (divergence) add_array(xml, offset, "divergence", 1);
+      if (gradient) add_array(xml, offset, "density gradient", 3);
+      xml += "      </PointData>\n    </Piece>\n  </ImageData>\n  <AppendedData encoding=\"raw\">\n   _";
+
+      FILE *out = fopen((stem + name).c_str(), "wb");
+      if (!out)
+      {
+            write_failed = true;
+            return;
+      }
+      write_failed |= fwrite(xml.data(), 1, xml.size(), out) != xml.size();
+      write_array(out, array[VelocityX], array[VelocityY]);
+      write_array(out, array[Density], NULL);
+      if (vorticity) write_array(out, array[Vorticity], NULL);
+      if (divergence) write_array(out, array[Divergence], NULL);
+      if (gradient) write_array(out, array[GradientX], array[GradientY]);
+      fputs("\n  </AppendedData>\n</VTKFile>\n", out);
+      write_failed |= fclose(out) != 0;
+
+      //the entry goes over the footer, which is written again after it
+      write_failed |= fprintf(collection, "    <DataSet timestep=\"%ld\" part=\"0\" file=\"%s%s\"/>\n%s",
+                              snapshot.step, base.c_str(), name, FOOTER) < 0 || fflush(collection) != 0 ||
+                      fseek(collection, -(long)strlen(FOOTER), SEEK_CUR) != 0;
+      exported.fetch_add(1, memory_order_relaxed);
+}
+
+//--- SOLVER SIDE --------------------------------------------------------------------------------------------------
+
+//record: Copy the velocity, the density and the derivative fields set in the bit mask 'derivatives' of a published
+//        frame into a snapshot, if the step is one to export. Called by the solver; drops the step if the writer
+//        has not written the snapshot yet.
+void VtkExporter::record(FieldSet const &fields, int derivatives)
+{
+      if (writer.enter() && fields.n == grid && fields.step % interval == 0)
+      {
+            Snapshot &snapshot = snapshots[writer.filling()];
+            if (!writer.available()) dropped.fetch_add(1, memory_order_relaxed);
+            else
+            {
+                  size_t nn = (size_t)grid * grid;
+                  const fftw_real *source[ArraySize] = {fields.vx, fields.vy, fields.rho, fields.vorticity,
+                                                        fields.divergence, fields.grad_x, fields.grad_y};
+                  snapshot.derivatives = with_derivatives ? derivatives : 0;
+                  for (int a = 0; a < ArraySize; a++)
+                  {
+                        bool wanted = a <= Density ||
+                                      (a == Vorticity && snapshot.derivatives >> Simulation::Vorticity & 1) ||
+                                      (a == Divergence && snapshot.derivatives >> Simulation::Divergence & 1) ||
+                                      (a >= GradientX && snapshot.derivatives >> Simulation::DensityGradient & 1);
+                        if (wanted) memcpy(&snapshot.values[a * nn], source[a], nn * sizeof(fftw_real));
+                  }
+                  snapshot.step = fields.step;
+                  writer.hand_over();
+            }
+      }
+      writer.leave();
+}
+
+
+//--- CONTROL ------------------------------------------------------------------------------------------------------
+
+//start: Start exporting every 'every'-th step of an n*n grid, to the collection at 'path' (a .pvd file) and one
+//       .vti file per step next to it, named after it and numbered from 0. With 'derived', the derivative fields the solver computes
+//       are exported too.
+bool VtkExporter::start(const char *path, int n, int every, bool derived)
+{
+      if (writer.is_open()) return true;
+      collection = fopen(path, "wb");
+      if (!collection) return false;
+
+      stem = path;
+      if (stem.size() > 4 && stem.compare(stem.size() - 4, 4, ".pvd") == 0) stem.resize(stem.size() - 4);
+      base = stem.substr(stem.find_last_of('/') + 1);     //the collection names its files relative to itself
+      grid = n;
+      interval = max(every, 1);
+      with_derivatives = derived;
+      for (int s = 0; s < SNAPSHOTS; s++)
+            snapshots[s].values.resize((derived ? ArraySize : Density + 1) * (size_t)n * n);
+      exported.store(0);
+      dropped.store(0);
+      written_bytes = 0;
+
+      write_failed = fprintf(collection, "<?xml version=\"1.0\"?>\n"
+                             "<VTKFile type=\"Collection\" version=\"0.1\" byte_order=\"%s\">\n  <Collection>\n%s",
+                             byte_order(), FOOTER) < 0 || fflush(collection) != 0 ||
+                     fseek(collection, -(long)strlen(FOOTER), SEEK_CUR) != 0;
+
+      writer.start(SNAPSHOTS, write_snapshot);
+      return true;
+}
+
+//stop: Stop exporting, write the snapshots still waiting and close the collection. Returns false if not all
+//      files could be written.
+bool VtkExporter::stop()
+{
+      if (!writer.is_open()) return false;
+      writer.close();
+      writer.finish();
+      write_failed |= fclose(collection) != 0;
+      collection = NULL;
+      for (int s = 0; s < SNAPSHOTS; s++) vector<fftw_real>().swap(snapshots[s].values);
+      vector<fftw_real>().swap(buffer);
+
+      printf("Exported %ld steps to %s.pvd: %.1f MB\n", exported.load(), stem.c_str(), written_bytes / 1e6);
+      if (dropped.load()) fprintf(stderr, "VTK writer fell behind, dropped %ld steps\n", dropped.load());
+      return !write_failed;
+}
+
+bool VtkExporter::exporting()
+{
+      return writer.is_open();
+}
@@ -0,0 +1,26 @@
+#ifndef VTKEXPORTER_HPP
+#define VTKEXPORTER_HPP
+
+class FieldSet;
+
+// Export of the published frames to ParaView: one VTK image data file (.vti) per exported step, with the velocity
+// as a vector array, the density and, if asked for, the derivative fields the solver computes, all stored as
+// appended raw binary. A .pvd collection lists the files by step and is kept valid after every file, so a run can
+// be opened while it is still being exported. The solver only copies the fields into one of a few snapshots; a
+// background thread writes them. When all snapshots are still waiting to be written, the step is dropped and
+// counted instead, so exporting never slows the solver down.
+class VtkExporter
+{
+
+
+public:
+	static bool start(const char *path, int n, int every = 1, bool derived = false);
+	static bool stop();
+	static bool exporting();
+	static void record(FieldSet const &fields, int derivatives);
+
+	static const int SNAPSHOTS = 8;			//steps that can wait for the writer
+
+};
+
+#endif